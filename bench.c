@@ -0,0 +1,371 @@
+/*
+ * ============================================
+ * file: bench.c
+ *
+ * @brief Microbenchmarks of the public API of
+ *        streaming_service.h. Every benchmark runs
+ *        a batch of calls against a freshly built
+ *        state of controlled size, with the event
+ *        output sent to /dev/null, and reports the
+ *        time per call over several repetitions along
+ *        with a power law fitted across state sizes.
+ * @see   Compile using supplied Makefile by running: make bench
+ * ============================================
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "streaming_service.h"
+
+/* default state sizes, users and distributed movies */
+#define BENCH_DEFAULT_SIZES "250,500,1000,2000"
+
+/* default repetitions kept, and discarded first */
+#define BENCH_DEFAULT_REPS 7
+#define BENCH_DEFAULT_WARMUP 2
+
+/* calls timed per repetition of the cheap benchmarks */
+#define BENCH_BATCH 100
+
+/* titles every user of the state has watched */
+#define BENCH_WATCHES_PER_USER 16
+
+#define BENCH_MAX_SIZES 32
+
+struct bench_case {
+    const char *name;
+    unsigned (*prepare)(unsigned size);   /* extra untimed setup, returns the calls to time */
+    void (*run)(unsigned size, unsigned calls);
+};
+
+struct bench_result {
+    const char *name;
+    unsigned size, calls, reps;
+    double mean, stddev, min;              /* nanoseconds per call */
+};
+
+struct bench_fit {
+    const char *name;
+    double coefficient, exponent, r2;      /* ns per call ~ coefficient * size ^ exponent */
+};
+
+/* the instance every benchmark runs on, rebuilt for each state */
+static struct streaming_service service;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+/*xorshift, so that every run builds the same states*/
+static unsigned next_random(unsigned bound) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return (unsigned)(rngState % bound);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*State of size n: n users, n distributed movies, BENCH_WATCHES_PER_USER watches per user*/
+static void build_state(unsigned size) {
+    unsigned i, w;
+    service_init_structures(&service);
+    for (i = 1; i <= size; i++) {
+        service_register_user(&service, (int)i);
+    }
+    for (i = 1; i <= size; i++) {
+        service_add_new_movie(&service, i, (movieCategory_t)(i % service.categoryCount), 1990 + i % 30);
+    }
+    service_distribute_new_movies(&service);
+    for (i = 1; i <= size; i++) {
+        for (w = 0; w < BENCH_WATCHES_PER_USER; w++) {
+            service_watch_movie(&service, (int)i, 1 + next_random(size));
+        }
+    }
+}
+
+static unsigned prepare_batch(unsigned size) {
+    (void)size;
+    return BENCH_BATCH;
+}
+
+static unsigned prepare_suggest(unsigned size) {
+    (void)size;
+    return BENCH_WATCHES_PER_USER;
+}
+
+static unsigned prepare_distribute(unsigned size) {
+    unsigned i;
+    for (i = 0; i < size / 4; i++) {
+        service_add_new_movie(&service, size + 1 + next_random(size), (movieCategory_t)next_random(service.categoryCount), 1990 + next_random(30));
+    }
+    return 1;
+}
+
+static void run_register(unsigned size, unsigned calls) {
+    unsigned i;
+    for (i = 1; i <= calls; i++) {
+        service_register_user(&service, (int)(size + i));
+    }
+}
+
+static void run_unregister(unsigned size, unsigned calls) {
+    unsigned i;
+    for (i = 0; i < calls; i++) {
+        service_unregister_user(&service, (int)(1 + (uint64_t)i * size / calls));
+    }
+}
+
+static void run_add_new_movie(unsigned size, unsigned calls) {
+    unsigned i;
+    for (i = 0; i < calls; i++) {
+        service_add_new_movie(&service, size + 1 + next_random(size), (movieCategory_t)next_random(service.categoryCount), 1990 + next_random(30));
+    }
+}
+
+static void run_distribute(unsigned size, unsigned calls) {
+    (void)size;
+    (void)calls;
+    service_distribute_new_movies(&service);
+}
+
+static void run_watch(unsigned size, unsigned calls) {
+    unsigned i;
+    for (i = 0; i < calls; i++) {
+        service_watch_movie(&service, (int)(1 + next_random(size)), 1 + next_random(size));
+    }
+}
+
+static void run_suggest(unsigned size, unsigned calls) {
+    unsigned i;
+    for (i = 0; i < calls; i++) {
+        service_suggest_movies(&service, (int)(1 + next_random(size)));
+    }
+}
+
+static void run_filtered_search(unsigned size, unsigned calls) {
+    unsigned i;
+    for (i = 0; i < calls; i++) {
+        service_filtered_movie_search(&service, (int)(1 + next_random(size)), (movieCategory_t)next_random(service.categoryCount),
+                (movieCategory_t)next_random(service.categoryCount), 1990 + next_random(30));
+    }
+}
+
+static void run_take_off(unsigned size, unsigned calls) {
+    unsigned i;
+    for (i = 0; i < calls; i++) {
+        service_take_off_movie(&service, 1 + (unsigned)((uint64_t)i * size / calls));
+    }
+}
+
+static const struct bench_case cases[] = {
+    { "register_user", prepare_batch, run_register },
+    { "unregister_user", prepare_batch, run_unregister },
+    { "add_new_movie", prepare_batch, run_add_new_movie },
+    { "distribute_new_movies", prepare_distribute, run_distribute },
+    { "watch_movie", prepare_batch, run_watch },
+    { "suggest_movies", prepare_suggest, run_suggest },
+    { "filtered_movie_search", prepare_batch, run_filtered_search },
+    { "take_off_movie", prepare_batch, run_take_off },
+};
+
+#define BENCH_CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+/*One repetition: build, time the calls, tear down. Returns ns per call*/
+static double run_once(const struct bench_case *bench, unsigned size, unsigned *calls) {
+    double start, elapsed;
+    build_state(size);
+    *calls = bench->prepare(size);
+    fflush(stdout);
+    start = now_ns();
+    bench->run(size, *calls);
+    fflush(stdout);
+    elapsed = now_ns() - start;
+    service_destroy_structures(&service);
+    return elapsed / *calls;
+}
+
+static void measure(const struct bench_case *bench, unsigned size, unsigned warmup, unsigned reps,
+        struct bench_result *result) {
+    double sum = 0, squares = 0;
+    unsigned i;
+
+    for (i = 0; i < warmup; i++) {
+        run_once(bench, size, &result->calls);
+    }
+    result->name = bench->name;
+    result->size = size;
+    result->reps = reps;
+    result->min = 0;
+    for (i = 0; i < reps; i++) {
+        double ns = run_once(bench, size, &result->calls);
+        sum += ns;
+        squares += ns * ns;
+        if (i == 0 || ns < result->min) {
+            result->min = ns;
+        }
+    }
+    result->mean = sum / reps;
+    result->stddev = reps > 1 ? sqrt(fmax(0, (squares - sum * sum / reps) / (reps - 1))) : 0;
+}
+
+/*Least squares fit of log(ns per call) against log(size) over count results*/
+static void fit_power_law(const struct bench_result *results, unsigned count, struct bench_fit *fit) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, syy = 0, det;
+    unsigned i;
+
+    fit->name = results[0].name;
+    for (i = 0; i < count; i++) {
+        double x = log(results[i].size), y = log(fmax(results[i].mean, 1e-3));
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        syy += y * y;
+    }
+    det = count * sxx - sx * sx;
+    if (count < 2 || det == 0) {
+        fit->exponent = 0;
+        fit->coefficient = results[0].mean;
+        fit->r2 = 0;
+        return;
+    }
+    fit->exponent = (count * sxy - sx * sy) / det;
+    fit->coefficient = exp((sy - fit->exponent * sx) / count);
+    {
+        double explained = fit->exponent * (sxy - sx * sy / count);
+        double total = syy - sy * sy / count;
+        fit->r2 = total > 0 ? explained / total : 1;
+    }
+}
+
+static void print_csv(FILE *out, const struct bench_result *results, unsigned resultCount,
+        const struct bench_fit *fits, unsigned fitCount) {
+    unsigned i;
+    fprintf(out, "api,size,calls,reps,mean_ns,stddev_ns,min_ns\n");
+    for (i = 0; i < resultCount; i++) {
+        fprintf(out, "%s,%u,%u,%u,%.1f,%.1f,%.1f\n", results[i].name, results[i].size, results[i].calls,
+                results[i].reps, results[i].mean, results[i].stddev, results[i].min);
+    }
+    fprintf(out, "\napi,coefficient_ns,exponent,r2\n");
+    for (i = 0; i < fitCount; i++) {
+        fprintf(out, "%s,%.4g,%.3f,%.3f\n", fits[i].name, fits[i].coefficient, fits[i].exponent, fits[i].r2);
+    }
+}
+
+static void print_json(FILE *out, const struct bench_result *results, unsigned resultCount,
+        const struct bench_fit *fits, unsigned fitCount) {
+    unsigned i;
+    fprintf(out, "{\n  \"results\": [\n");
+    for (i = 0; i < resultCount; i++) {
+        fprintf(out, "    {\"api\": \"%s\", \"size\": %u, \"calls\": %u, \"reps\": %u, "
+                "\"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"min_ns\": %.1f}%s\n",
+                results[i].name, results[i].size, results[i].calls, results[i].reps,
+                results[i].mean, results[i].stddev, results[i].min, i + 1 < resultCount ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"fits\": [\n");
+    for (i = 0; i < fitCount; i++) {
+        fprintf(out, "    {\"api\": \"%s\", \"coefficient_ns\": %.4g, \"exponent\": %.3f, \"r2\": %.3f}%s\n",
+                fits[i].name, fits[i].coefficient, fits[i].exponent, fits[i].r2, i + 1 < fitCount ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static int parse_sizes(const char *text, unsigned *sizes) {
+    int count = 0;
+    char *end;
+    while (*text != '\0' && count < BENCH_MAX_SIZES) {
+        unsigned long size = strtoul(text, &end, 10);
+        if (end == text || size < 8 || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        sizes[count++] = (unsigned)size;
+        text = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--format csv|json] [--sizes n,n,...] [--reps n] [--warmup n] [--only api]\n", program);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned sizes[BENCH_MAX_SIZES];
+    unsigned reps = BENCH_DEFAULT_REPS, warmup = BENCH_DEFAULT_WARMUP;
+    const char *format = "csv", *only = NULL;
+    struct bench_result *results;
+    struct bench_fit fits[BENCH_CASE_COUNT];
+    unsigned resultCount = 0, fitCount = 0, c;
+    int sizeCount = parse_sizes(BENCH_DEFAULT_SIZES, sizes), i, s, savedStdout, devNull;
+
+    for (i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        } else if (strcmp(argv[i], "--format") == 0) {
+            format = argv[++i];
+        } else if (strcmp(argv[i], "--sizes") == 0) {
+            sizeCount = parse_sizes(argv[++i], sizes);
+        } else if (strcmp(argv[i], "--reps") == 0) {
+            reps = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0) {
+            warmup = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--only") == 0) {
+            only = argv[++i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (sizeCount <= 0 || reps == 0 || (strcmp(format, "csv") != 0 && strcmp(format, "json") != 0)) {
+        usage(argv[0]);
+    }
+
+    results = (struct bench_result *)malloc(BENCH_CASE_COUNT * sizeCount * sizeof(struct bench_result));
+    if (results == NULL || service_load_category_names(&service, NULL) != 0) {
+        fprintf(stderr, "Could not allocate benchmark results\n");
+        return EXIT_FAILURE;
+    }
+
+    /*The events print their results, keep them out of the report*/
+    fflush(stdout);
+    savedStdout = dup(STDOUT_FILENO);
+    devNull = open("/dev/null", O_WRONLY);
+    if (savedStdout < 0 || devNull < 0 || dup2(devNull, STDOUT_FILENO) < 0) {
+        perror("could not redirect the event output");
+        return EXIT_FAILURE;
+    }
+    close(devNull);
+
+    for (c = 0; c < BENCH_CASE_COUNT; c++) {
+        unsigned first = resultCount;
+        if (only != NULL && strcmp(only, cases[c].name) != 0) {
+            continue;
+        }
+        for (s = 0; s < sizeCount; s++) {
+            measure(&cases[c], sizes[s], warmup, reps, &results[resultCount++]);
+            fprintf(stderr, "%s size %u: %.1f ns/op\n", cases[c].name, sizes[s], results[resultCount - 1].mean);
+        }
+        fit_power_law(&results[first], resultCount - first, &fits[fitCount++]);
+    }
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    if (strcmp(format, "json") == 0) {
+        print_json(stdout, results, resultCount, fits, fitCount);
+    } else {
+        print_csv(stdout, results, resultCount, fits, fitCount);
+    }
+    free(results);
+    service_free_category_names(&service);
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * ============================================
+ * file: compat_check.c
+ *
+ * @brief Drives the compatibility API of
+ *        streaming_service.h end to end, the way a
+ *        caller written against the former global
+ *        service does, with no category table loaded
+ *        beforehand. make check compares its output
+ *        with testfiles/expected/compat_check.out.
+ * @see   Compile using supplied Makefile by running: make compat_check
+ * ============================================
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "streaming_service.h"
+
+int main(void)
+{
+	const int categories[] = { HORROR, DRAMA, COMEDY };
+	const unsigned doomed[] = { 7, 9 };
+
+	init_structures();
+	register_user(1);
+	register_user(2);
+	add_new_movie(5, HORROR, 2000);
+	add_new_movie(7, DRAMA, 2010);
+	add_new_movie(9, COMEDY, 1995);
+	add_new_movie(3, HORROR, 1980);
+	distribute_new_movies();
+	watch_movie(1, 5);
+	watch_movie(2, 5);
+	watch_movie(2, 7);
+	filtered_movie_search(1, HORROR, DRAMA, 1990);
+	multi_category_search(2, categories, 3, 1985);
+	cowatch_suggest_movies(1, 2);
+	most_watched_movies(2, ALL_CATEGORIES);
+	printf("Category %d is %s\n", COMEDY, get_category_name(COMEDY));
+	take_off_movie(5);
+	take_off_movies(doomed, 2);
+	print_movies();
+	print_users();
+	unregister_user(2);
+	print_users();
+	destroy_structures();
+	return 0;
+}
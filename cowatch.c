@@ -0,0 +1,485 @@
+#include <stdlib.h>
+#include "cowatch.h"
+#include "open_hash.h"
+
+/*initial sizes, must be powers of two*/
+#define COWATCH_INITIAL_ROWS 256
+#define COWATCH_INITIAL_CELLS 4
+
+static uint32_t row_hash(const void *row, const void *context) {
+    (void)context;
+    return hash_u32(((const struct cowatch_row *)row)->mid);
+}
+
+static int row_matches(const void *row, const void *mid, const void *context) {
+    (void)context;
+    return ((const struct cowatch_row *)row)->mid == *(const unsigned *)mid;
+}
+
+static int row_empty(const void *row) {
+    return ((const struct cowatch_row *)row)->cells == NULL;
+}
+
+static uint32_t cell_hash(const void *cell, const void *context) {
+    (void)context;
+    return hash_u32(((const struct cowatch_cell *)cell)->mid);
+}
+
+static int cell_matches(const void *cell, const void *mid, const void *context) {
+    (void)context;
+    return ((const struct cowatch_cell *)cell)->mid == *(const unsigned *)mid;
+}
+
+static int cell_empty(const void *cell) {
+    return ((const struct cowatch_cell *)cell)->count == 0;
+}
+
+static uint32_t score_hash(const void *sum, const void *context) {
+    (void)context;
+    return hash_u32(((const struct cowatch_score *)sum)->mid);
+}
+
+static int score_matches(const void *sum, const void *mid, const void *context) {
+    (void)context;
+    return ((const struct cowatch_score *)sum)->mid == *(const unsigned *)mid;
+}
+
+static int score_empty(const void *sum) {
+    return ((const struct cowatch_score *)sum)->score == 0;
+}
+
+/*rows stay under half full, cells under three quarters, the sums of cowatch_top are sized up front*/
+static const struct open_hash_type rowType = {
+    sizeof(struct cowatch_row), 2, row_hash, row_matches, row_empty
+};
+static const struct open_hash_type cellType = {
+    sizeof(struct cowatch_cell), 3, cell_hash, cell_matches, cell_empty
+};
+static const struct open_hash_type scoreType = {
+    sizeof(struct cowatch_score), 2, score_hash, score_matches, score_empty
+};
+
+int cowatch_init(struct cowatch_matrix *matrix, size_t maxCells) {
+    matrix->rows = (struct cowatch_row *)calloc(COWATCH_INITIAL_ROWS, sizeof(struct cowatch_row));
+    if (matrix->rows == NULL) {
+        return -1;
+    }
+    matrix->rowMask = COWATCH_INITIAL_ROWS - 1;
+    matrix->rowUsed = 0;
+    matrix->cellCount = 0;
+    matrix->maxCells = maxCells;
+    matrix->prunedCells = 0;
+    return 0;
+}
+
+void cowatch_destroy(struct cowatch_matrix *matrix) {
+    uint32_t i;
+    if (matrix->rows == NULL) {
+        return;
+    }
+    for (i = 0; i <= matrix->rowMask; i++) {
+        free(matrix->rows[i].cells);
+    }
+    free(matrix->rows);
+    matrix->rows = NULL;
+    matrix->rowMask = 0;
+    matrix->rowUsed = 0;
+    matrix->cellCount = 0;
+}
+
+/*Position of the row of mid, or of the unused row where it would go*/
+static uint32_t row_position(const struct cowatch_matrix *matrix, unsigned mid) {
+    return open_hash_probe(&rowType, NULL, matrix->rows, matrix->rowMask, hash_u32(mid), &mid);
+}
+
+/*Row of mid, created empty if needed*/
+static struct cowatch_row *row_find_or_create(struct cowatch_matrix *matrix, unsigned mid) {
+    uint32_t pos = row_position(matrix, mid);
+    struct cowatch_row *rows, *row;
+    if (matrix->rows[pos].cells != NULL) {
+        return &matrix->rows[pos];
+    }
+    rows = (struct cowatch_row *)open_hash_reserve(&rowType, NULL, matrix->rows, &matrix->rowMask, matrix->rowUsed);
+    if (rows == NULL) {
+        return NULL;
+    }
+    if (rows != matrix->rows) {
+        matrix->rows = rows;
+        pos = row_position(matrix, mid);
+    }
+    row = &matrix->rows[pos];
+    row->cells = (struct cowatch_cell *)calloc(COWATCH_INITIAL_CELLS, sizeof(struct cowatch_cell));
+    if (row->cells == NULL) {
+        return NULL;
+    }
+    row->mid = mid;
+    row->used = 0;
+    row->mask = COWATCH_INITIAL_CELLS - 1;
+    matrix->rowUsed++;
+    return row;
+}
+
+/*Position of the cell of mid inside row, or of the empty cell where it would go*/
+static uint32_t cell_position(const struct cowatch_row *row, unsigned mid) {
+    return open_hash_probe(&cellType, NULL, row->cells, row->mask, hash_u32(mid), &mid);
+}
+
+/*Make sure row can take one more cell without failing*/
+static int row_reserve(struct cowatch_row *row) {
+    struct cowatch_cell *cells = (struct cowatch_cell *)open_hash_reserve(&cellType, NULL, row->cells, &row->mask,
+            row->used);
+    if (cells == NULL) {
+        return -1;
+    }
+    row->cells = cells;
+    return 0;
+}
+
+/*Add one to cell col of row, which was reserved*/
+static void row_increment(struct cowatch_matrix *matrix, struct cowatch_row *row, unsigned col) {
+    struct cowatch_cell *cell = &row->cells[cell_position(row, col)];
+    if (cell->count != 0) {
+        if (cell->count != UINT32_MAX) {
+            cell->count++;
+        }
+        return;
+    }
+    cell->mid = col;
+    cell->count = 1;
+    row->used++;
+    matrix->cellCount++;
+}
+
+/*counts below this are told apart by the pruning histogram, higher ones share its last bucket*/
+#define COWATCH_PRUNE_HISTOGRAM 1024
+
+/*The two cells of a pair hold the same count, the one in the row of the smaller mid stands for both*/
+static int pair_first(const struct cowatch_row *row, const struct cowatch_cell *cell) {
+    return cell->count != 0 && row->mid < cell->mid;
+}
+
+/*Pair of rows a and b, the smaller mid in the high half*/
+static uint64_t pair_key(unsigned a, unsigned b) {
+    return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+static int count_compare(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int key_compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*Count of the drop-th lowest pair; *ties is set to how many pairs of that count go along with the lower ones*/
+static uint32_t prune_cut(const struct cowatch_matrix *matrix, size_t drop, size_t *ties) {
+    size_t histogram[COWATCH_PRUNE_HISTOGRAM] = {0};
+    size_t below = 0, high, n = 0, lower;
+    uint32_t value, i, c, *counts;
+
+    for (i = 0; i <= matrix->rowMask; i++) {
+        const struct cowatch_row *row = &matrix->rows[i];
+        for (c = 0; row->cells != NULL && c <= row->mask; c++) {
+            if (pair_first(row, &row->cells[c])) {
+                histogram[row->cells[c].count < COWATCH_PRUNE_HISTOGRAM ? row->cells[c].count
+                        : COWATCH_PRUNE_HISTOGRAM - 1]++;
+            }
+        }
+    }
+    for (value = 1; value < COWATCH_PRUNE_HISTOGRAM - 1; value++) {
+        if (below + histogram[value] >= drop) {
+            *ties = drop - below;
+            return value;
+        }
+        below += histogram[value];
+    }
+
+    /*The cut lies among the high counts, sort them to find it*/
+    high = histogram[COWATCH_PRUNE_HISTOGRAM - 1];
+    *ties = drop - below;
+    counts = (uint32_t *)malloc(high * sizeof(uint32_t));
+    if (counts == NULL) {
+        return COWATCH_PRUNE_HISTOGRAM - 1; /*drop high counts as if they were equal*/
+    }
+    for (i = 0; i <= matrix->rowMask; i++) {
+        const struct cowatch_row *row = &matrix->rows[i];
+        for (c = 0; row->cells != NULL && c <= row->mask; c++) {
+            if (pair_first(row, &row->cells[c]) && row->cells[c].count >= COWATCH_PRUNE_HISTOGRAM - 1) {
+                counts[n++] = row->cells[c].count;
+            }
+        }
+    }
+    qsort(counts, n, sizeof(uint32_t), count_compare);
+    value = counts[*ties - 1];
+    lower = *ties - 1;
+    while (lower > 0 && counts[lower - 1] == value) {
+        lower--;
+    }
+    *ties -= lower; /*the lower high counts all go*/
+    free(counts);
+    return value;
+}
+
+/*Largest key of the pairs at the cut that go, the ties smallest keys; all of them go if they cannot be sorted*/
+static uint64_t prune_tie_key(const struct cowatch_matrix *matrix, uint32_t cut, size_t ties) {
+    size_t n = 0, capacity = 0;
+    uint64_t *keys = NULL, *grown, key;
+    uint32_t i, c;
+
+    for (i = 0; i <= matrix->rowMask; i++) {
+        const struct cowatch_row *row = &matrix->rows[i];
+        for (c = 0; row->cells != NULL && c <= row->mask; c++) {
+            if (!pair_first(row, &row->cells[c]) || row->cells[c].count != cut) {
+                continue;
+            }
+            if (n == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                grown = (uint64_t *)realloc(keys, capacity * sizeof(uint64_t));
+                if (grown == NULL) {
+                    free(keys);
+                    return UINT64_MAX;
+                }
+                keys = grown;
+            }
+            keys[n++] = pair_key(row->mid, row->cells[c].mid);
+        }
+    }
+    if (n <= ties) {
+        free(keys);
+        return UINT64_MAX;
+    }
+    qsort(keys, n, sizeof(uint64_t), key_compare);
+    key = keys[ties - 1];
+    free(keys);
+    return key;
+}
+
+/*A cell goes with its pair, so the decision is the same in the partner row*/
+static int cell_pruned(const struct cowatch_row *row, const struct cowatch_cell *cell, uint32_t cut, size_t ties,
+        uint64_t tieKey) {
+    if (cell->count == 0 || cell->count > cut) {
+        return 0;
+    }
+    return cell->count < cut || (ties > 0 && pair_key(row->mid, cell->mid) <= tieKey);
+}
+
+/*Drop the pairs of lowest count, in both of their rows, until a quarter of the budget is free again*/
+static void cowatch_prune(struct cowatch_matrix *matrix) {
+    size_t ties, target = matrix->maxCells / 4 * 3;
+    uint32_t cut = prune_cut(matrix, (matrix->cellCount - target + 1) / 2, &ties);
+    uint64_t tieKey = ties > 0 ? prune_tie_key(matrix, cut, ties) : 0;
+    uint32_t i, c;
+
+    for (i = 0; i <= matrix->rowMask; i++) {
+        struct cowatch_row *row = &matrix->rows[i];
+        struct cowatch_cell *oldCells = row->cells;
+        uint32_t oldMask = row->mask, before = row->used, kept = 0, mask;
+        if (oldCells == NULL) {
+            continue;
+        }
+        for (c = 0; c <= oldMask; c++) {
+            if (oldCells[c].count != 0 && !cell_pruned(row, &oldCells[c], cut, ties, tieKey)) {
+                kept++;
+            }
+        }
+        if (kept == before) {
+            continue;
+        }
+
+        /*Rebuild the row once, its table shrunk along with its contents*/
+        mask = oldMask;
+        while (mask + 1 > COWATCH_INITIAL_CELLS && (size_t)kept * 4 < (size_t)mask + 1) {
+            mask >>= 1;
+        }
+        row->cells = (struct cowatch_cell *)calloc((size_t)mask + 1, sizeof(struct cowatch_cell));
+        if (row->cells == NULL) {
+            row->cells = oldCells;
+            continue;
+        }
+        row->mask = mask;
+        row->used = 0;
+        for (c = 0; c <= oldMask; c++) {
+            if (oldCells[c].count != 0 && !cell_pruned(row, &oldCells[c], cut, ties, tieKey)) {
+                open_hash_place(&cellType, NULL, row->cells, mask, &oldCells[c]);
+                row->used++;
+            }
+        }
+        free(oldCells);
+        matrix->cellCount -= before - row->used;
+        matrix->prunedCells += before - row->used;
+    }
+}
+
+int cowatch_add_pair(struct cowatch_matrix *matrix, unsigned a, unsigned b) {
+    struct cowatch_row *rowA, *rowB;
+    size_t cellsBefore = matrix->cellCount;
+    if (a == b) {
+        return 0;
+    }
+    /*Both rows take their cell or neither does, the pair stays symmetric*/
+    if (row_find_or_create(matrix, a) == NULL || (rowB = row_find_or_create(matrix, b)) == NULL) {
+        return -1;
+    }
+    rowA = &matrix->rows[row_position(matrix, a)];
+    if (row_reserve(rowA) != 0 || row_reserve(rowB) != 0) {
+        return -1;
+    }
+    row_increment(matrix, rowA, b);
+    row_increment(matrix, rowB, a);
+    /*Only a new pair can take the matrix over its budget*/
+    if (matrix->cellCount > cellsBefore && matrix->cellCount > matrix->maxCells) {
+        cowatch_prune(matrix);
+    }
+    return 0;
+}
+
+void cowatch_remove_movie(struct cowatch_matrix *matrix, unsigned mid) {
+    uint32_t pos = row_position(matrix, mid), mask = matrix->rows[pos].mask, c;
+    struct cowatch_cell *cells = matrix->rows[pos].cells;
+    if (cells == NULL) {
+        return;
+    }
+    matrix->cellCount -= matrix->rows[pos].used;
+    open_hash_remove(&rowType, NULL, matrix->rows, matrix->rowMask, pos);
+    matrix->rowUsed--;
+
+    /*Drop the mirrored cell from the row of every partner*/
+    for (c = 0; c <= mask; c++) {
+        struct cowatch_row *partner;
+        uint32_t at;
+        if (cells[c].count == 0) {
+            continue;
+        }
+        partner = &matrix->rows[row_position(matrix, cells[c].mid)];
+        if (partner->cells == NULL) {
+            continue;
+        }
+        at = cell_position(partner, mid);
+        if (partner->cells[at].count != 0) {
+            open_hash_remove(&cellType, NULL, partner->cells, partner->mask, at);
+            partner->used--;
+            matrix->cellCount--;
+        }
+    }
+    free(cells);
+}
+
+size_t cowatch_bytes(const struct cowatch_matrix *matrix) {
+    size_t bytes = ((size_t)matrix->rowMask + 1) * sizeof(struct cowatch_row);
+    uint32_t i;
+    for (i = 0; i <= matrix->rowMask; i++) {
+        if (matrix->rows[i].cells != NULL) {
+            bytes += ((size_t)matrix->rows[i].mask + 1) * sizeof(struct cowatch_cell);
+        }
+    }
+    return bytes;
+}
+
+/*a ranks before b*/
+static int score_better(const struct cowatch_score *a, const struct cowatch_score *b) {
+    return a->score > b->score || (a->score == b->score && a->mid < b->mid);
+}
+
+/*Restore the heap below pos, the worst score sits at the root*/
+static void heap_sift_down(struct cowatch_score *heap, unsigned size, unsigned pos) {
+    for (;;) {
+        unsigned worst = pos, l = 2 * pos + 1, r = 2 * pos + 2;
+        struct cowatch_score tmp;
+        if (l < size && score_better(&heap[worst], &heap[l])) {
+            worst = l;
+        }
+        if (r < size && score_better(&heap[worst], &heap[r])) {
+            worst = r;
+        }
+        if (worst == pos) {
+            return;
+        }
+        tmp = heap[pos];
+        heap[pos] = heap[worst];
+        heap[worst] = tmp;
+        pos = worst;
+    }
+}
+
+static void heap_sift_up(struct cowatch_score *heap, unsigned pos) {
+    while (pos > 0 && score_better(&heap[(pos - 1) / 2], &heap[pos])) {
+        struct cowatch_score tmp = heap[pos];
+        heap[pos] = heap[(pos - 1) / 2];
+        heap[(pos - 1) / 2] = tmp;
+        pos = (pos - 1) / 2;
+    }
+}
+
+int cowatch_top(const struct cowatch_matrix *matrix, const unsigned *titles, unsigned count,
+        unsigned n, struct cowatch_score *top) {
+    struct cowatch_score *sums;
+    size_t cells = 0;
+    uint32_t mask = 15, i, j;
+    unsigned size = 0, t;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    /*Scratch table big enough for every cell of the rows involved*/
+    for (t = 0; t < count; t++) {
+        const struct cowatch_row *row = &matrix->rows[row_position(matrix, titles[t])];
+        cells += row->used;
+    }
+    while ((size_t)mask + 1 < cells * 2) {
+        mask = mask * 2 + 1;
+    }
+    sums = (struct cowatch_score *)calloc((size_t)mask + 1, sizeof(struct cowatch_score));
+    if (sums == NULL) {
+        return -1;
+    }
+
+    for (t = 0; t < count; t++) {
+        const struct cowatch_row *row = &matrix->rows[row_position(matrix, titles[t])];
+        if (row->cells == NULL) {
+            continue;
+        }
+        for (i = 0; i <= row->mask; i++) {
+            uint32_t pos;
+            if (row->cells[i].count == 0) {
+                continue;
+            }
+            pos = open_hash_probe(&scoreType, NULL, sums, mask, hash_u32(row->cells[i].mid), &row->cells[i].mid);
+            sums[pos].mid = row->cells[i].mid;
+            sums[pos].score += row->cells[i].count;
+        }
+    }
+
+    /*Keep the n best candidates in a heap, skipping the titles; no cell refers to a movie taken off*/
+    for (i = 0; i <= mask; i++) {
+        int isTitle = 0;
+        if (sums[i].score == 0) {
+            continue;
+        }
+        for (t = 0; t < count && !isTitle; t++) {
+            isTitle = titles[t] == sums[i].mid;
+        }
+        if (isTitle) {
+            continue;
+        }
+        if (size < n) {
+            top[size] = sums[i];
+            heap_sift_up(top, size++);
+        } else if (score_better(&sums[i], &top[0])) {
+            top[0] = sums[i];
+            heap_sift_down(top, size, 0);
+        }
+    }
+    free(sums);
+
+    /*Heap sort, the worst remaining candidate goes last*/
+    for (j = size; j > 1; j--) {
+        struct cowatch_score tmp = top[0];
+        top[0] = top[j - 1];
+        top[j - 1] = tmp;
+        heap_sift_down(top, j - 1, 0);
+    }
+    return (int)size;
+}
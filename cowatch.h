@@ -0,0 +1,83 @@
+/*
+ * ============================================
+ * file: cowatch.h
+ *
+ * @brief Sparse co-watch matrix. Row mid holds, in
+ *        a small hash table, how many times each other
+ *        movie was watched close to mid by the same user.
+ *        The matrix is symmetric and bounded: once it
+ *        holds more than maxCells cells, the pairs of
+ *        lowest count are pruned from both of their rows.
+ * ============================================
+ */
+
+#ifndef __COWATCH_H__
+#define __COWATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* number of previously watched titles paired with a new watch */
+#define COWATCH_WINDOW 5
+
+/* default bound on the number of non-zero cells */
+#define COWATCH_DEFAULT_MAX_CELLS (1u << 22)
+
+struct cowatch_cell {
+    unsigned mid;
+    uint32_t count; /* 0 marks an empty cell */
+};
+
+struct cowatch_row {
+    unsigned mid;
+    uint32_t used;               /* non-empty cells */
+    uint32_t mask;               /* cell count - 1, 0 for an unused row */
+    struct cowatch_cell *cells;  /* NULL for an unused row */
+};
+
+struct cowatch_matrix {
+    struct cowatch_row *rows;    /* open addressing on the row mid */
+    uint32_t rowMask;
+    uint32_t rowUsed;
+    size_t cellCount;            /* non-empty cells over all rows */
+    size_t maxCells;
+    size_t prunedCells;          /* cells dropped by pruning so far */
+};
+
+/* one line of a co-watch answer */
+struct cowatch_score {
+    unsigned mid;
+    uint64_t score;
+};
+
+/*
+ * Prepares an empty matrix holding at most maxCells cells.
+ * Returns 0 on success, -1 on failure
+ */
+int cowatch_init(struct cowatch_matrix *matrix, size_t maxCells);
+
+/* Releases every row */
+void cowatch_destroy(struct cowatch_matrix *matrix);
+
+/*
+ * Counts one co-watch of movies a and b in both rows.
+ * Returns 0 on success, -1 on failure
+ */
+int cowatch_add_pair(struct cowatch_matrix *matrix, unsigned a, unsigned b);
+
+/* Drops the row of movie mid and its cell in every other row, e.g. once it is taken off */
+void cowatch_remove_movie(struct cowatch_matrix *matrix, unsigned mid);
+
+/* Bytes held by the row table and the cell tables of every row */
+size_t cowatch_bytes(const struct cowatch_matrix *matrix);
+
+/*
+ * Sums the rows of the count titles and fills top with
+ * up to n movies of highest total, titles themselves
+ * excluded, highest first and smaller mid first on ties.
+ * Returns the number of movies written, or -1 on failure
+ */
+int cowatch_top(const struct cowatch_matrix *matrix, const unsigned *titles, unsigned count,
+        unsigned n, struct cowatch_score *top);
+
+#endif
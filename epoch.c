@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+#include "epoch.h"
+
+void epoch_init(struct epoch_domain *domain) {
+    int i;
+    atomic_init(&domain->global, 1);
+    for (i = 0; i < EPOCH_MAX_READERS; i++) {
+        atomic_init(&domain->slots[i], EPOCH_IDLE);
+    }
+    domain->retired = NULL;
+    domain->retiredHead = 0;
+    domain->retiredCount = 0;
+    domain->retiredCap = 0;
+}
+
+/*Give one retired entry back to its allocator*/
+static void release(struct epoch_retired *entry) {
+    if (entry->pool != NULL) {
+        node_pool_free(entry->pool, entry->idx);
+    } else {
+        free(entry->ptr);
+    }
+}
+
+void epoch_destroy(struct epoch_domain *domain) {
+    size_t i;
+    for (i = 0; i < domain->retiredCount; i++) {
+        release(&domain->retired[(domain->retiredHead + i) % domain->retiredCap]);
+    }
+    free(domain->retired);
+    domain->retired = NULL;
+    domain->retiredHead = domain->retiredCount = domain->retiredCap = 0;
+}
+
+int epoch_pin(struct epoch_domain *domain) {
+    int slot;
+    for (slot = 0; slot < EPOCH_MAX_READERS; slot++) {
+        uint64_t expected = EPOCH_IDLE;
+        if (atomic_compare_exchange_strong(&domain->slots[slot], &expected, EPOCH_CLAIMED)) {
+            /*Publish the pin, then make sure the epoch did not move meanwhile*/
+            for (;;) {
+                uint64_t epoch = atomic_load(&domain->global);
+                atomic_store(&domain->slots[slot], epoch);
+                if (atomic_load(&domain->global) == epoch) {
+                    return slot;
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+void epoch_unpin(struct epoch_domain *domain, int slot) {
+    atomic_store_explicit(&domain->slots[slot], EPOCH_IDLE, memory_order_release);
+}
+
+/*Append to the ring of retired entries, doubling it when full*/
+static int retire(struct epoch_domain *domain, struct node_pool *pool, uint32_t idx, void *ptr) {
+    struct epoch_retired *entry;
+    if (domain->retiredCount == domain->retiredCap) {
+        size_t newCap = domain->retiredCap ? domain->retiredCap * 2 : 256, i;
+        struct epoch_retired *grown = (struct epoch_retired *)malloc(newCap * sizeof(*grown));
+        if (grown == NULL) {
+            return -1;
+        }
+        for (i = 0; i < domain->retiredCount; i++) {
+            grown[i] = domain->retired[(domain->retiredHead + i) % domain->retiredCap];
+        }
+        free(domain->retired);
+        domain->retired = grown;
+        domain->retiredHead = 0;
+        domain->retiredCap = newCap;
+    }
+    entry = &domain->retired[(domain->retiredHead + domain->retiredCount) % domain->retiredCap];
+    entry->epoch = atomic_load_explicit(&domain->global, memory_order_relaxed);
+    entry->pool = pool;
+    entry->idx = idx;
+    entry->ptr = ptr;
+    domain->retiredCount++;
+    return 0;
+}
+
+int epoch_retire_node(struct epoch_domain *domain, struct node_pool *pool, uint32_t idx) {
+    return retire(domain, pool, idx, NULL);
+}
+
+int epoch_retire_ptr(struct epoch_domain *domain, void *ptr) {
+    return retire(domain, NULL, NIL_INDEX, ptr);
+}
+
+void epoch_advance(struct epoch_domain *domain) {
+    uint64_t oldest = atomic_fetch_add(&domain->global, 1) + 1;
+    int slot;
+
+    /*Entries retired before the oldest pinned epoch are unreachable*/
+    for (slot = 0; slot < EPOCH_MAX_READERS; slot++) {
+        uint64_t pinned = atomic_load(&domain->slots[slot]);
+        if (pinned == EPOCH_CLAIMED) {
+            pinned = oldest - 1; /*pinning right now, at worst at the epoch just closed*/
+        }
+        if (pinned != EPOCH_IDLE && pinned < oldest) {
+            oldest = pinned;
+        }
+    }
+    while (domain->retiredCount > 0 && domain->retired[domain->retiredHead].epoch < oldest) {
+        release(&domain->retired[domain->retiredHead]);
+        domain->retiredHead = (domain->retiredHead + 1) % domain->retiredCap;
+        domain->retiredCount--;
+    }
+}
+
+size_t epoch_pending(const struct epoch_domain *domain) {
+    return domain->retiredCount;
+}
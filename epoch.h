@@ -0,0 +1,81 @@
+/*
+ * ============================================
+ * file: epoch.h
+ *
+ * @brief Epoch based reclamation. Readers pin the
+ *        current epoch in a slot while they traverse
+ *        published data, without taking any lock. The
+ *        single writer retires what it unpublished and
+ *        frees it once no slot is pinned at the epoch
+ *        of retirement or an older one.
+ * ============================================
+ */
+
+#ifndef __EPOCH_H__
+#define __EPOCH_H__
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "node_pool.h"
+
+/* readers that may be pinned at the same time */
+#define EPOCH_MAX_READERS 64
+
+/* value of a slot nobody holds */
+#define EPOCH_IDLE 0
+
+/* value of a slot being claimed, not pinned yet */
+#define EPOCH_CLAIMED UINT64_MAX
+
+/* one retired node of a pool, or one malloc'd block when pool is NULL */
+struct epoch_retired {
+    uint64_t epoch;
+    struct node_pool *pool;
+    uint32_t idx;
+    void *ptr;
+};
+
+struct epoch_domain {
+    _Atomic uint64_t global;                      /* starts at 1, EPOCH_IDLE is never an epoch */
+    _Atomic uint64_t slots[EPOCH_MAX_READERS];    /* pinned epoch of each reader */
+    struct epoch_retired *retired;                /* writer only, in increasing epoch order */
+    size_t retiredHead, retiredCount, retiredCap;
+};
+
+/* Prepares a domain with no reader and nothing retired */
+void epoch_init(struct epoch_domain *domain);
+
+/* Frees everything still retired, no reader may be pinned */
+void epoch_destroy(struct epoch_domain *domain);
+
+/*
+ * Pins the current epoch in a free slot, from any thread.
+ * Published data read afterwards stays valid until the
+ * slot is unpinned. Returns the slot, or -1 if all slots
+ * are taken
+ */
+int epoch_pin(struct epoch_domain *domain);
+
+/* Releases slot, from any thread */
+void epoch_unpin(struct epoch_domain *domain, int slot);
+
+/*
+ * Writer only: node idx of pool, or block ptr, was
+ * unpublished and must outlive the current readers.
+ * Returns 0 on success, -1 if it could not be queued
+ * (it is then leaked rather than freed too early)
+ */
+int epoch_retire_node(struct epoch_domain *domain, struct node_pool *pool, uint32_t idx);
+int epoch_retire_ptr(struct epoch_domain *domain, void *ptr);
+
+/*
+ * Writer only, after publishing: starts a new epoch and
+ * frees what no pinned reader can still reach
+ */
+void epoch_advance(struct epoch_domain *domain);
+
+/* Retired entries not freed yet */
+size_t epoch_pending(const struct epoch_domain *domain);
+
+#endif
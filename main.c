@@ -15,12 +15,22 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "perf_counters.h"
+#include "replay.h"
+#include "server.h"
 #include "streaming_service.h"
 
 /* Maximum input line size */
 #define MAX_LINE 1024
 
+/* Most consecutive T events taken off in one sweep */
+#define TAKEOFF_BATCH 4096
+
+/* Event types handle_event_line executes, the only ones --perf attributes */
+#define EVENT_TYPES "RUADWSFGTKCQMP"
+
 /* 
  * Uncomment the following line to
  * enable debugging prints
@@ -33,186 +43,545 @@
 #define DPRINT(...)
 #endif /* DEBUG */
 
-struct user *userList = NULL; /*Initialize the users list*/
-struct new_movie *newMoviesList = NULL; /*Initialize the list of new movies*/
-struct movie *categoryLists[CATEGORY_COUNT] = { NULL }; /*Initialize category-specific lists*/
-
-void init_structures(void) {
-    int i;
-
-    /*Initialize category-specific and new movies lists*/
-    newMoviesList = NULL;
-    for (i = 0; i < CATEGORY_COUNT; i++) {
-        categoryLists[i] = NULL;
-    }
-
-    /*Allocate memory for the sentinel node*/
-    userList = (struct user *)malloc(sizeof(struct user));
-    if (userList == NULL) {
-        /*Handle the memory allocation error*/
-        return;
-    }
-
-    /*Initialize the sentinel node*/
-    userList->uid = SENTINEL_UID;
-    userList->suggestedHead = NULL;
-    userList->suggestedTail = NULL;
-    userList->watchHistory = NULL;
-    userList->next = NULL;
-}
+/*
+ * Parses the movie IDs of a T line, "T <mid> [mid ...]",
+ * into mids, up to the first token that is not a number.
+ * Sets *clean if nothing but whitespace follows them.
+ * Returns how many, 0 if line is not such a line
+ */
+static unsigned parse_takeoff_line(const char *line, unsigned *mids, unsigned max, int *clean)
+{
+	unsigned count = 0;
+	char *end;
 
-void destroy_structures(void) {
-    int i; /*initialize the variable here because of ansi standard*/
-	/*Free the user list*/
-    while (userList != NULL) {
-        struct user *tempUser = userList;
-        userList = userList->next;
-
-        /*Free suggested movie list for each user*/
-        while (tempUser->suggestedHead != NULL) {
-            struct suggested_movie *tempSuggested = tempUser->suggestedHead;
-            tempUser->suggestedHead = tempUser->suggestedHead->next;
-            free(tempSuggested);
-        }
-
-        /*Free watch history for each user*/
-        while (tempUser->watchHistory != NULL) {
-            struct movie *tempMovie = tempUser->watchHistory;
-            tempUser->watchHistory = tempUser->watchHistory->next;
-            free(tempMovie);
-        }
-
-        /*Finally free the user itself*/
-        free(tempUser);
-    }
-
-    /*Free new movies list*/
-    while (newMoviesList != NULL) {
-        struct new_movie *tempNewMovie = newMoviesList;
-        newMoviesList = newMoviesList->next;
-        free(tempNewMovie);
-    }
-
-    /*Free category-specific movie lists*/
-    for (i = 0; i < CATEGORY_COUNT; i++) {
-        while (categoryLists[i] != NULL) {
-            struct movie *tempCategoryMovie = categoryLists[i];
-            categoryLists[i] = categoryLists[i]->next;
-            free(tempCategoryMovie);
-        }
-    }
+	*clean = 0;
+	while (isspace((unsigned char)*line))
+		line++;
+	if (*line != 'T')
+		return 0;
+	line++;
+	while (count < max) {
+		unsigned long value;
+		while (isspace((unsigned char)*line))
+			line++;
+		/* signed like sscanf's %u, which wraps negative numbers */
+		if (!isdigit((unsigned char)*line)
+				&& !((*line == '-' || *line == '+') && isdigit((unsigned char)line[1])))
+			break;
+		value = strtoul(line, &end, 10);
+		mids[count++] = (unsigned)value;
+		line = end;
+	}
+	while (isspace((unsigned char)*line))
+		line++;
+	*clean = *line == '\0';
+	return count;
 }
 
-int main(int argc, char *argv[])
+/*
+ * Parses an F line, "F <uid> <category1> <category2> <year>",
+ * or a G line, "G <uid> <year> [category ...]", into
+ * its user, categories and year.
+ * Returns 0 on success, -1 if line is neither
+ */
+static int parse_search_line(const char *line, int *uid, int *categories, unsigned *count, unsigned *year)
 {
-	FILE *event_file;
-	char line_buffer[MAX_LINE];
+	char *cursor, *end;
 
-	if (argc != 2) {
-		fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
-		exit(EXIT_FAILURE);
+	while (isspace((unsigned char)*line))
+		line++;
+	if (*line == 'F') {
+		*count = 2;
+		return sscanf(line, "F %d %d %d %u", uid, &categories[0], &categories[1], year) == 4 ? 0 : -1;
 	}
-
-	event_file = fopen(argv[1], "r");
-	if (!event_file) {
-		perror("fopen error for event file open");
-		exit(EXIT_FAILURE);
+	if (*line != 'G' || sscanf(line, "G %d %u", uid, year) != 2)
+		return -1;
+	/* skip the event, uid and year, the rest are categories */
+	cursor = (char *)line + 1;
+	strtol(cursor, &cursor, 10);
+	strtoul(cursor, &cursor, 10);
+	for (*count = 0; *count < MAX_LINE / 2; (*count)++) {
+		long value = strtol(cursor, &end, 10);
+		if (end == cursor)
+			break;
+		categories[*count] = (int)value;
+		cursor = end;
 	}
+	return 0;
+}
 
-	init_structures();
-	while (fgets(line_buffer, MAX_LINE, event_file)) {
-		char *trimmed_line;
-		char event;
-		int uid;
-		unsigned mid, year;
-		movieCategory_t category1, category2;
-		/*
-		 * First trim any whitespace
-		 * leading the line.
-		 */
-		trimmed_line = line_buffer;
-		while (trimmed_line && isspace(*trimmed_line))
-			trimmed_line++;
-		if (!trimmed_line)
-			continue;
-		/* 
-		 * Find the event,
-		 * or comment starting with #
-		 */
-		if (sscanf(trimmed_line, "%c", &event) != 1) {
-			fprintf(stderr, "Could not parse event type out of input line:\n\t%s", trimmed_line);
-			fclose(event_file);
-			exit(EXIT_FAILURE);
-		}
+/*
+ * Executes the event found on one input line on service.
+ * Returns -1 if no event type could be parsed
+ * out of the line, 0 otherwise
+ */
+int handle_event_line(struct streaming_service *service, char *line_buffer)
+{
+	char *trimmed_line;
+	char event;
+	int uid, category, clean;
+	int categories[MAX_LINE / 2];
+	unsigned mids[MAX_LINE / 2];
+	unsigned mid, year, k, count;
+	movieCategory_t category1;
+	/*
+	 * First trim any whitespace
+	 * leading the line.
+	 */
+	trimmed_line = line_buffer;
+	while (trimmed_line && isspace(*trimmed_line))
+		trimmed_line++;
+	if (!trimmed_line)
+		return 0;
+	/* 
+	 * Find the event,
+	 * or comment starting with #
+	 */
+	if (sscanf(trimmed_line, "%c", &event) != 1) {
+		fprintf(stderr, "Could not parse event type out of input line:\n\t%s", trimmed_line);
+		return -1;
+	}
 
-		switch (event) {
-			/* Comment, ignore this line */
-			case '#':
-				break;
-			case 'R':
-				if (sscanf(trimmed_line, "R %d", &uid) != 1) {
-					fprintf(stderr, "Event R parsing error\n");
-					break;
-				}
-				register_user(uid);
+	switch (event) {
+		/* Comment, ignore this line */
+		case '#':
+			break;
+		case 'R':
+			if (sscanf(trimmed_line, "R %d", &uid) != 1) {
+				fprintf(stderr, "Event R parsing error\n");
 				break;
-			case 'U':
-				if (sscanf(trimmed_line, "U %d", &uid) != 1) {
-					fprintf(stderr, "Event U parsing error\n");
-					break;
-				}
-				unregister_user(uid);
+			}
+			service_register_user(service, uid);
+			break;
+		case 'U':
+			if (sscanf(trimmed_line, "U %d", &uid) != 1) {
+				fprintf(stderr, "Event U parsing error\n");
 				break;
-			case 'A':
-				if (sscanf(trimmed_line, "A %u %d %u", &mid, (int *)&category1, &year) != 3) {
-					fprintf(stderr, "Event A parsing error\n");
-					break;
-				}
-				add_new_movie(mid, category1, year);
+			}
+			service_unregister_user(service, uid);
+			break;
+		case 'A':
+			if (sscanf(trimmed_line, "A %u %d %u", &mid, (int *)&category1, &year) != 3) {
+				fprintf(stderr, "Event A parsing error\n");
 				break;
-			case 'D':
-				distribute_new_movies();
+			}
+			service_add_new_movie(service, mid, category1, year);
+			break;
+		case 'D':
+			service_distribute_new_movies(service);
+			break;
+		case 'W':
+			if (sscanf(trimmed_line, "W %d %u", &uid, &mid) != 2) {
+				fprintf(stderr, "Event W parsing error\n");
 				break;
-			case 'W':
-				if (sscanf(trimmed_line, "W %d %u", &uid, &mid) != 2) {
-					fprintf(stderr, "Event W parsing error\n");
-					break;
-				}
-				watch_movie(uid, mid);
+			}
+			service_watch_movie(service, uid, mid);
+			break;
+		case 'S':
+			if (sscanf(trimmed_line, "S %d", &uid) != 1) {
+				fprintf(stderr, "Event S parsing error\n");
 				break;
-			case 'S':
-				if (sscanf(trimmed_line, "S %d", &uid) != 1) {
-					fprintf(stderr, "Event S parsing error\n");
-					break;
-				}
-				suggest_movies(uid);
+			}
+			service_suggest_movies(service, uid);
+			break;
+		case 'F':
+		case 'G':
+			if (parse_search_line(trimmed_line, &uid, categories, &count, &year) != 0) {
+				fprintf(stderr, "Event %c parsing error\n", event);
 				break;
-			case 'F':
-				if (sscanf(trimmed_line, "F %d %d %d %u", &uid, (int *)&category1, (int *)&category2, &year) != 4) {
-					fprintf(stderr, "Event F parsing error\n");
-					break;
-				}
-				filtered_movie_search(uid, category1, category2, year);
+			}
+			if (event == 'F')
+				service_filtered_movie_search(service, uid, (movieCategory_t)categories[0],
+						(movieCategory_t)categories[1], year);
+			else
+				service_multi_category_search(service, uid, categories, count, year);
+			break;
+		case 'C':
+			if (sscanf(trimmed_line, "C %d %u", &uid, &k) != 2) {
+				fprintf(stderr, "Event C parsing error\n");
 				break;
-			case 'T':
-				if (sscanf(trimmed_line, "T %u", &mid) != 1) {
-					fprintf(stderr, "Event T parsing error\n");
-					break;
-				}
-				take_off_movie(mid);
+			}
+			service_cowatch_suggest_movies(service, uid, k);
+			break;
+		case 'T':
+			count = parse_takeoff_line(trimmed_line, mids, MAX_LINE / 2, &clean);
+			if (count == 0) {
+				fprintf(stderr, "Event T parsing error\n");
 				break;
-			case 'M':
-				print_movies();
-				break;
-			case 'P':
-				print_users();
-				break;
-			default:
-				fprintf(stderr, "WARNING: Unrecognized event %c. Continuing...\n", event);
+			}
+			service_take_off_movies(service, mids, count);
+			break;
+		case 'K':
+			category = ALL_CATEGORIES;
+			if (sscanf(trimmed_line, "K %u %d", &k, &category) < 1) {
+				fprintf(stderr, "Event K parsing error\n");
 				break;
+			}
+			service_most_watched_movies(service, k, category);
+			break;
+		case 'Q':
+			service_print_memory(service);
+			break;
+		case 'M':
+			service_print_movies(service);
+			break;
+		case 'P':
+			service_print_users(service);
+			break;
+		default:
+			fprintf(stderr, "WARNING: Unrecognized event %c. Continuing...\n", event);
+			break;
+	}
+	return 0;
+}
+
+/* Counter deltas per event type, NULL unless --perf is given */
+static struct perf_attribution *attribution;
+
+/* Executes one event line, attributing its counter deltas to its event type */
+static int dispatch_event_line(struct streaming_service *service, char *line_buffer)
+{
+	const char *type = line_buffer;
+	int status;
+
+	while (isspace((unsigned char)*type))
+		type++;
+	/* Blank lines, comments and unknown types open no counter group */
+	if (attribution == NULL || *type == '\0' || strchr(EVENT_TYPES, *type) == NULL)
+		return handle_event_line(service, line_buffer);
+	perf_attribution_begin(attribution);
+	status = handle_event_line(service, line_buffer);
+	perf_attribution_end(attribution, *type, 1);
+	return status;
+}
+
+/* Takes off the movies of lines coalesced T lines, attributed as that many T events */
+static void dispatch_takeoffs(struct streaming_service *service, const unsigned *mids, unsigned count, unsigned lines)
+{
+	if (attribution == NULL) {
+		service_take_off_movies(service, mids, count);
+		return;
+	}
+	perf_attribution_begin(attribution);
+	service_take_off_movies(service, mids, count);
+	perf_attribution_end(attribution, 'T', lines);
+}
+
+/*
+ * Replays the events of event_file on service, the
+ * consecutive T events taken off together in one sweep.
+ * Returns the number of events, -1 if a line holds none
+ */
+static long replay_events(struct streaming_service *service, FILE *event_file)
+{
+	char line_buffer[MAX_LINE];
+	unsigned takeoffs[TAKEOFF_BATCH];
+	unsigned takeoff_count = 0, takeoff_lines = 0;
+	long events = 0;
+
+	while (fgets(line_buffer, MAX_LINE, event_file)) {
+		int clean;
+		unsigned count = parse_takeoff_line(line_buffer, takeoffs + takeoff_count, TAKEOFF_BATCH - takeoff_count, &clean);
+		/* Only T lines that parse cleanly are coalesced, the others run alone */
+		if (!clean)
+			count = 0;
+		if (count > 0) {
+			takeoff_count += count;
+			takeoff_lines++;
+			if (takeoff_count < TAKEOFF_BATCH)
+				continue;
+		}
+		if (takeoff_count > 0) {
+			dispatch_takeoffs(service, takeoffs, takeoff_count, takeoff_lines);
+			events += takeoff_lines;
+			takeoff_count = takeoff_lines = 0;
+		}
+		if (count == 0) {
+			if (dispatch_event_line(service, line_buffer) != 0)
+				return -1;
+			events++;
+		}
+	}
+	if (takeoff_count > 0) {
+		dispatch_takeoffs(service, takeoffs, takeoff_count, takeoff_lines);
+		events += takeoff_lines;
+	}
+	return events;
+}
+
+/* Service settings given on the command line, applied to every replayed file */
+struct replay_settings {
+	const char *category_file;
+	unsigned suggested_cap;
+	size_t cowatch_cells;
+};
+
+/* Replay hook: replays one event file on a service of its own */
+static long replay_file_events(void *context, FILE *in, FILE *out)
+{
+	const struct replay_settings *settings = (const struct replay_settings *)context;
+	struct streaming_service service = {0};
+	long events;
+
+	service.suggestedCap = settings->suggested_cap;
+	service.cowatchCells = settings->cowatch_cells;
+	service.out = out;
+	if (service_load_category_names(&service, settings->category_file) != 0)
+		return -1;
+	service_init_structures(&service);
+	events = replay_events(&service, in);
+	service_destroy_structures(&service);
+	service_free_category_names(&service);
+	return events;
+}
+
+/*
+ * Prints the exit reports, memory first. The memory report
+ * goes where the events print, as Q does; the counters
+ * are measurements of this run and go to stderr
+ */
+static void print_exit_reports(struct streaming_service *service)
+{
+	fprintf(service->out, "Memory at exit:\n");
+	service_print_memory_usage(service, service->out);
+	fflush(service->out);
+	if (attribution != NULL) {
+		fprintf(stderr, "Performance counters per event:\n");
+		perf_attribution_report(attribution, stderr);
+	}
+}
+
+/* A snapshot pinned by pin_snapshot_event, with the service it belongs to */
+struct pinned_event {
+	struct streaming_service *service;
+	struct category_snapshot snapshot;
+};
+
+/* Server hook: executes one line on the service in context */
+static int handle_server_line(void *context, char *line_buffer)
+{
+	return dispatch_event_line((struct streaming_service *)context, line_buffer);
+}
+
+/*
+ * Server hook: pins a snapshot for an event that only
+ * reads the category lists, so that a reader thread can
+ * answer it while the following events run. Returns
+ * NULL for any other event. P stays on the event thread:
+ * the users' lists are changed in place by W, S, F, G, C
+ * and T and freed by U, and versioning them would put a
+ * copy into every one of those events for the sake of P
+ */
+static void *pin_snapshot_event(void *context, const char *line_buffer)
+{
+	struct pinned_event *pinned;
+
+	while (isspace((unsigned char)*line_buffer))
+		line_buffer++;
+	if (*line_buffer != 'M')
+		return NULL;
+	pinned = (struct pinned_event *)malloc(sizeof(struct pinned_event));
+	if (pinned == NULL)
+		return NULL;
+	pinned->service = (struct streaming_service *)context;
+	if (service_category_snapshot_pin(pinned->service, &pinned->snapshot) != 0) {
+		free(pinned);
+		return NULL;
+	}
+	return pinned;
+}
+
+/* Server hook: answers an event pinned by pin_snapshot_event */
+static void read_snapshot_event(void *snapshot, FILE *out)
+{
+	struct pinned_event *pinned = (struct pinned_event *)snapshot;
+
+	service_print_movies_snapshot(pinned->service, pinned->snapshot.lists, out);
+	service_category_snapshot_unpin(pinned->service, &pinned->snapshot);
+	free(pinned);
+}
+
+/* An F or G event whose merge a reader thread does ahead, on a pinned snapshot */
+struct prefetched_search {
+	struct streaming_service *service;
+	struct category_snapshot snapshot;
+	struct suggestion_merge merge;
+	char event;
+	int uid;
+	unsigned year, count;
+	int categories[MAX_LINE / 2];
+};
+
+/*
+ * Server hook: pins a snapshot for an F or G event, so
+ * that a reader thread merges its categories before its
+ * batch runs. Returns NULL for any other event
+ */
+static void *prefetch_search_event(void *context, const char *line_buffer)
+{
+	struct prefetched_search *search;
+
+	while (isspace((unsigned char)*line_buffer))
+		line_buffer++;
+	if (*line_buffer != 'F' && *line_buffer != 'G')
+		return NULL;
+	search = (struct prefetched_search *)malloc(sizeof(struct prefetched_search));
+	if (search == NULL)
+		return NULL;
+	search->service = (struct streaming_service *)context;
+	search->event = *line_buffer;
+	search->merge.slots = NULL;
+	search->merge.count = 0;
+	if (parse_search_line(line_buffer, &search->uid, search->categories, &search->count, &search->year) != 0
+			|| service_category_snapshot_pin(search->service, &search->snapshot) != 0) {
+		free(search);
+		return NULL;
+	}
+	return search;
+}
+
+/* Server hook: merges the categories of a prefetched search on its snapshot */
+static void merge_search_event(void *work)
+{
+	struct prefetched_search *search = (struct prefetched_search *)work;
+
+	service_merge_suggestions(search->service, search->snapshot.lists, search->categories, search->count,
+			search->year, &search->merge);
+}
+
+/*
+ * Server hook: executes a prefetched search, splicing
+ * its merge into the user's suggestions. A D or T of the
+ * batch that published new category lists since the
+ * snapshot makes the event merge again instead
+ */
+static int handle_prefetched_line(void *context, char *line_buffer, void *work)
+{
+	struct streaming_service *service = (struct streaming_service *)context;
+	struct prefetched_search *search = (struct prefetched_search *)work;
+	int status = 0;
+
+	if (search->snapshot.lists != service_current_category_lists(service)) {
+		status = dispatch_event_line(service, line_buffer);
+	} else {
+		if (attribution != NULL)
+			perf_attribution_begin(attribution);
+		if (search->event == 'F')
+			service_filtered_movie_search_merged(service, search->uid, (movieCategory_t)search->categories[0],
+					(movieCategory_t)search->categories[1], search->year, &search->merge);
+		else
+			service_multi_category_search_merged(service, search->uid, search->categories, search->count,
+					search->year, &search->merge);
+		if (attribution != NULL)
+			perf_attribution_end(attribution, search->event, 1);
+	}
+	service_suggestion_merge_free(&search->merge);
+	service_category_snapshot_unpin(service, &search->snapshot);
+	free(search);
+	return status;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *event_file;
+	const char *program = argv[0], *category_file = NULL;
+	static struct streaming_service service;
+	static struct perf_attribution perf;
+
+	/* Leading options, --perf alone, the others with one argument */
+	while (argc >= 2) {
+		if (strcmp(argv[1], "--perf") == 0) {
+			attribution = &perf;
+			argv++;
+			argc--;
+			continue;
+		}
+		if (argc >= 3 && strcmp(argv[1], "--categories") == 0)
+			category_file = argv[2];
+		else if (argc >= 3 && strcmp(argv[1], "--suggest-cap") == 0)
+			service.suggestedCap = (unsigned)strtoul(argv[2], NULL, 10);
+		else if (argc >= 3 && strcmp(argv[1], "--cowatch-cells") == 0)
+			service.cowatchCells = (size_t)strtoull(argv[2], NULL, 10);
+		else
+			break;
+		argv += 2;
+		argc -= 2;
+	}
+	if (service_load_category_names(&service, category_file) != 0) {
+		fprintf(stderr, "Could not load the category table\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (argc >= 4 && strcmp(argv[1], "--replay") == 0) {
+		struct replay_settings settings;
+		struct replay_config config;
+
+		/* Counters are per thread, the workers have none */
+		if (attribution != NULL) {
+			fprintf(stderr, "--perf is not supported with --replay, ignored\n");
+			attribution = NULL;
 		}
+		settings.category_file = category_file;
+		settings.suggested_cap = service.suggestedCap;
+		settings.cowatch_cells = service.cowatchCells;
+		config.threads = atoi(argv[2]);
+		config.replay = replay_file_events;
+		config.context = &settings;
+		service_free_category_names(&service);
+		return run_replay(argv + 3, argc - 3, &config) == 0 ? 0 : EXIT_FAILURE;
+	}
+
+	if (argc >= 3 && strcmp(argv[1], "--server") == 0) {
+		struct server_config config;
+		int status;
+
+		config.windowUs = argc >= 4 ? atol(argv[3]) : SERVER_DEFAULT_WINDOW_US;
+		config.readers = argc >= 5 ? atoi(argv[4]) : 0;
+		config.handle = handle_server_line;
+		config.pin = pin_snapshot_event;
+		config.read = read_snapshot_event;
+		config.prefetch = prefetch_search_event;
+		config.runPrefetch = merge_search_event;
+		config.handlePrefetched = handle_prefetched_line;
+		config.context = &service;
+
+		service_init_structures(&service);
+		if (attribution != NULL)
+			perf_attribution_init(attribution);
+		status = run_server(argv[2], &config);
+		print_exit_reports(&service);
+		if (attribution != NULL)
+			perf_attribution_destroy(attribution);
+		service_destroy_structures(&service);
+		service_free_category_names(&service);
+		return status == 0 ? 0 : EXIT_FAILURE;
+	}
+
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s [--categories <category_file>] [--suggest-cap <n>] [--cowatch-cells <n>] [--perf] <input_file>\n", program);
+		fprintf(stderr, "       %s [--categories <category_file>] [--suggest-cap <n>] [--cowatch-cells <n>] [--perf] --server <socket_path> [batch_window_us [reader_threads]]\n", program);
+		fprintf(stderr, "       %s [--categories <category_file>] [--suggest-cap <n>] [--cowatch-cells <n>] --replay <threads> <input_file> [input_file ...]\n", program);
+		exit(EXIT_FAILURE);
+	}
+
+	event_file = fopen(argv[1], "r");
+	if (!event_file) {
+		perror("fopen error for event file open");
+		exit(EXIT_FAILURE);
+	}
+
+	service_init_structures(&service);
+	if (attribution != NULL)
+		perf_attribution_init(attribution);
+	if (replay_events(&service, event_file) < 0) {
+		fclose(event_file);
+		exit(EXIT_FAILURE);
 	}
 	fclose(event_file);
-	destroy_structures();
+	print_exit_reports(&service);
+	if (attribution != NULL)
+		perf_attribution_destroy(attribution);
+	service_destroy_structures(&service);
+	service_free_category_names(&service);
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include <string.h>
+#include "mem_stats.h"
+
+void mem_stats_init(struct mem_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void mem_stats_alloc(struct mem_stats *stats, memKind_t kind, size_t bytes) {
+    struct mem_counter *counter = &stats->kinds[kind];
+    counter->nodes++;
+    counter->bytes += bytes;
+    if (counter->nodes > counter->peakNodes) {
+        counter->peakNodes = counter->nodes;
+    }
+    if (counter->bytes > counter->peakBytes) {
+        counter->peakBytes = counter->bytes;
+    }
+}
+
+void mem_stats_free(struct mem_stats *stats, memKind_t kind, size_t bytes) {
+    struct mem_counter *counter = &stats->kinds[kind];
+    counter->nodes--;
+    counter->bytes -= bytes;
+}
+
+void mem_stats_release_all(struct mem_stats *stats, memKind_t kind) {
+    stats->kinds[kind].nodes = 0;
+    stats->kinds[kind].bytes = 0;
+}
+
+/*The function returns the printable name of a kind of structure*/
+const char *mem_kind_name(memKind_t kind) {
+    switch (kind) {
+        case MEM_USERS:
+            return "Users";
+        case MEM_WATCH_HISTORIES:
+            return "Watch Histories";
+        case MEM_SUGGESTED_LISTS:
+            return "Suggested Lists";
+        case MEM_NEW_MOVIES:
+            return "New Movies";
+        case MEM_CATEGORY_LISTS:
+            return "Category Lists";
+        default:
+            return "Unknown";
+    }
+}
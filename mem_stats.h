@@ -0,0 +1,52 @@
+/*
+ * ============================================
+ * file: mem_stats.h
+ *
+ * @brief Byte and node counters, with their peaks,
+ *        for each kind of structure of the service.
+ *        Every allocation and free of such a structure
+ *        is reported here by its caller.
+ * ============================================
+ */
+
+#ifndef __MEM_STATS_H__
+#define __MEM_STATS_H__
+
+#include <stddef.h>
+
+typedef enum {
+	MEM_USERS,
+	MEM_WATCH_HISTORIES,
+	MEM_SUGGESTED_LISTS,
+	MEM_NEW_MOVIES,
+	MEM_CATEGORY_LISTS,
+	MEM_KIND_COUNT
+} memKind_t;
+
+struct mem_counter {
+    size_t nodes;
+    size_t bytes;
+    size_t peakNodes;
+    size_t peakBytes;
+};
+
+struct mem_stats {
+    struct mem_counter kinds[MEM_KIND_COUNT];
+};
+
+/* Zeroes every counter and peak */
+void mem_stats_init(struct mem_stats *stats);
+
+/* Accounts one node of bytes bytes allocated for kind */
+void mem_stats_alloc(struct mem_stats *stats, memKind_t kind, size_t bytes);
+
+/* Accounts one node of bytes bytes of kind being freed */
+void mem_stats_free(struct mem_stats *stats, memKind_t kind, size_t bytes);
+
+/* Accounts every node of kind as freed at once, peaks are kept */
+void mem_stats_release_all(struct mem_stats *stats, memKind_t kind);
+
+/* Printable name of kind */
+const char *mem_kind_name(memKind_t kind);
+
+#endif
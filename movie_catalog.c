@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include "open_hash.h"
+#include "streaming_service.h"
+
+/*initial number of buckets, must be a power of two*/
+#define CATALOG_INITIAL_BUCKETS 256
+
+/*Mix mid and year into a bucket position*/
+static uint32_t catalog_hash(unsigned mid, unsigned year) {
+    uint32_t h = (uint32_t)mid * 0x9E3779B1u;
+    h ^= (uint32_t)year * 0x85EBCA77u;
+    h ^= h >> 15;
+    return h;
+}
+
+static uint32_t bucket_hash(const void *bucket, const void *context) {
+    const struct movie_info *info = movie_catalog_info((const struct movie_catalog *)context, *(const uint32_t *)bucket);
+    return catalog_hash(info->mid, info->year);
+}
+
+static int bucket_matches(const void *bucket, const void *key, const void *context) {
+    const struct movie_info *info = movie_catalog_info((const struct movie_catalog *)context, *(const uint32_t *)bucket);
+    const struct movie_info *wanted = (const struct movie_info *)key;
+    return info->mid == wanted->mid && info->year == wanted->year;
+}
+
+/*buckets hold slot indices, the table stays under half full*/
+static const struct open_hash_type bucketType = {
+    sizeof(uint32_t), 2, bucket_hash, bucket_matches, open_hash_index_empty
+};
+
+int movie_catalog_init(struct movie_catalog *catalog) {
+    if (node_pool_init(&catalog->slots, sizeof(struct movie_info)) != 0) {
+        return -1;
+    }
+    catalog->buckets = (uint32_t *)calloc(CATALOG_INITIAL_BUCKETS, sizeof(uint32_t));
+    if (catalog->buckets == NULL) {
+        node_pool_destroy(&catalog->slots);
+        return -1;
+    }
+    catalog->bucketMask = CATALOG_INITIAL_BUCKETS - 1;
+    catalog->used = 0;
+    return 0;
+}
+
+void movie_catalog_destroy(struct movie_catalog *catalog) {
+    free(catalog->buckets);
+    catalog->buckets = NULL;
+    catalog->bucketMask = 0;
+    catalog->used = 0;
+    node_pool_destroy(&catalog->slots);
+}
+
+uint32_t movie_catalog_intern(struct movie_catalog *catalog, unsigned mid, unsigned year) {
+    struct movie_info key, *info;
+    uint32_t *buckets, pos, slot;
+
+    buckets = (uint32_t *)open_hash_reserve(&bucketType, catalog, catalog->buckets, &catalog->bucketMask, catalog->used);
+    if (buckets == NULL) {
+        return NIL_INDEX;
+    }
+    catalog->buckets = buckets;
+
+    key.mid = mid;
+    key.year = year;
+    pos = open_hash_probe(&bucketType, catalog, buckets, catalog->bucketMask, catalog_hash(mid, year), &key);
+    if (buckets[pos] != NIL_INDEX) {
+        return buckets[pos];
+    }
+
+    slot = node_pool_alloc(&catalog->slots);
+    if (slot == NIL_INDEX) {
+        return NIL_INDEX;
+    }
+    info = (struct movie_info *)node_pool_at(&catalog->slots, slot);
+    *info = key;
+    buckets[pos] = slot;
+    catalog->used++;
+    return slot;
+}
@@ -0,0 +1,48 @@
+/*
+ * ============================================
+ * file: movie_catalog.h
+ *
+ * @brief Interned movie information. Every distinct
+ *        (mid, year) pair is stored once in a catalog
+ *        slot and list nodes refer to it by its 32-bit
+ *        slot index.
+ * ============================================
+ */
+
+#ifndef __MOVIE_CATALOG_H__
+#define __MOVIE_CATALOG_H__
+
+#include <stdint.h>
+#include "node_pool.h"
+
+struct movie_info;
+
+struct movie_catalog {
+    struct node_pool slots; /* one struct movie_info per slot */
+    uint32_t *buckets;      /* open addressing table of slot indices, NIL_INDEX when empty */
+    uint32_t bucketMask;    /* bucket count - 1, the count is a power of two */
+    uint32_t used;          /* occupied buckets */
+};
+
+/*
+ * Prepares an empty catalog.
+ * Returns 0 on success, -1 on failure
+ */
+int movie_catalog_init(struct movie_catalog *catalog);
+
+/* Releases the slots and the lookup table */
+void movie_catalog_destroy(struct movie_catalog *catalog);
+
+/*
+ * Returns the slot holding (mid, year), creating it
+ * if this pair was never seen before. Returns NIL_INDEX
+ * on allocation failure
+ */
+uint32_t movie_catalog_intern(struct movie_catalog *catalog, unsigned mid, unsigned year);
+
+/* Movie information stored in slot */
+static inline const struct movie_info *movie_catalog_info(const struct movie_catalog *catalog, uint32_t slot) {
+    return (const struct movie_info *)node_pool_at(&catalog->slots, slot);
+}
+
+#endif
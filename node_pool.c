@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include <string.h>
+#include "node_pool.h"
+
+/*Prepare an empty pool, the chunk directory is zeroed memory so untouched entries cost nothing*/
+int node_pool_init(struct node_pool *pool, size_t elemSize) {
+    if (elemSize < sizeof(uint32_t)) {
+        elemSize = sizeof(uint32_t); /*freed nodes must be able to hold the free list link*/
+    }
+    pool->elemSize = elemSize;
+    pool->chunks = (unsigned char **)calloc(POOL_MAX_CHUNKS, sizeof(unsigned char *));
+    if (pool->chunks == NULL) {
+        return -1;
+    }
+    pool->chunkCount = 0;
+    pool->nextFresh = NIL_INDEX + 1; /*index 0 is reserved for the NULL link*/
+    pool->freeHead = NIL_INDEX;
+    pool->live = 0;
+    return 0;
+}
+
+/*Free every chunk and the directory itself*/
+void node_pool_destroy(struct node_pool *pool) {
+    uint32_t i;
+    if (pool->chunks == NULL) {
+        return;
+    }
+    for (i = 0; i < pool->chunkCount; i++) {
+        free(pool->chunks[i]);
+    }
+    free(pool->chunks);
+    pool->chunks = NULL;
+    pool->chunkCount = 0;
+    pool->nextFresh = NIL_INDEX + 1;
+    pool->freeHead = NIL_INDEX;
+    pool->live = 0;
+}
+
+/*Hand out a node, from the free list if possible, otherwise from the end of the last chunk*/
+uint32_t node_pool_alloc(struct node_pool *pool) {
+    uint32_t idx;
+
+    if (pool->freeHead != NIL_INDEX) {
+        idx = pool->freeHead;
+        memcpy(&pool->freeHead, node_pool_at(pool, idx), sizeof(uint32_t));
+        pool->live++;
+        return idx;
+    }
+
+    if (pool->nextFresh == 0) {
+        return NIL_INDEX; /*all 2^32 - 1 indices are in use*/
+    }
+    idx = pool->nextFresh;
+    if ((idx >> POOL_CHUNK_BITS) >= pool->chunkCount) {
+        unsigned char *chunk = (unsigned char *)malloc(POOL_CHUNK_SIZE * pool->elemSize);
+        if (chunk == NULL) {
+            return NIL_INDEX;
+        }
+        pool->chunks[pool->chunkCount++] = chunk;
+    }
+    pool->nextFresh++;
+    pool->live++;
+    return idx;
+}
+
+/*Push the node on the free list, the link is stored in the node's first bytes*/
+void node_pool_free(struct node_pool *pool, uint32_t idx) {
+    if (idx == NIL_INDEX) {
+        return;
+    }
+    memcpy(node_pool_at(pool, idx), &pool->freeHead, sizeof(uint32_t));
+    pool->freeHead = idx;
+    pool->live--;
+}
@@ -0,0 +1,63 @@
+/*
+ * ============================================
+ * file: node_pool.h
+ *
+ * @brief Pooled storage for fixed-size list nodes.
+ *        Nodes are addressed by 32-bit indices instead
+ *        of pointers, index NIL_INDEX being the NULL link.
+ *        Storage grows in chunks that never move, so an
+ *        index stays valid until the node is freed.
+ * ============================================
+ */
+
+#ifndef __NODE_POOL_H__
+#define __NODE_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* index used as the NULL link, never handed out by a pool */
+#define NIL_INDEX 0u
+
+/* each chunk holds 2^POOL_CHUNK_BITS nodes */
+#define POOL_CHUNK_BITS 12
+#define POOL_CHUNK_SIZE (1u << POOL_CHUNK_BITS)
+#define POOL_CHUNK_MASK (POOL_CHUNK_SIZE - 1)
+
+/* enough chunks to address every 32-bit index */
+#define POOL_MAX_CHUNKS (1u << (32 - POOL_CHUNK_BITS))
+
+struct node_pool {
+    size_t elemSize;         /* size of one node, at least 4 bytes */
+    unsigned char **chunks;  /* chunk directory, POOL_MAX_CHUNKS entries */
+    uint32_t chunkCount;     /* chunks allocated so far */
+    uint32_t nextFresh;      /* first index never handed out */
+    uint32_t freeHead;       /* head of the free list, threaded through freed nodes */
+    uint32_t live;           /* nodes currently allocated */
+};
+
+/*
+ * Prepares an empty pool for nodes of elemSize bytes.
+ * Returns 0 on success, -1 on failure
+ */
+int node_pool_init(struct node_pool *pool, size_t elemSize);
+
+/* Releases every chunk of the pool */
+void node_pool_destroy(struct node_pool *pool);
+
+/*
+ * Returns the index of a node, reusing freed ones first,
+ * or NIL_INDEX if no memory is available. The node contents
+ * are undefined.
+ */
+uint32_t node_pool_alloc(struct node_pool *pool);
+
+/* Gives node idx back to the pool */
+void node_pool_free(struct node_pool *pool, uint32_t idx);
+
+/* Address of node idx; idx must be a live index */
+static inline void *node_pool_at(const struct node_pool *pool, uint32_t idx) {
+    return pool->chunks[idx >> POOL_CHUNK_BITS] + (size_t)(idx & POOL_CHUNK_MASK) * pool->elemSize;
+}
+
+#endif
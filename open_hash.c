@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+#include "node_pool.h"
+#include "open_hash.h"
+
+#define SLOT(type, slots, pos) ((char *)(slots) + (size_t)(pos) * (type)->slotSize)
+
+void *open_hash_grow(const struct open_hash_type *type, const void *context, void *slots, uint32_t *mask) {
+    uint32_t newMask = *mask * 2 + 1, i;
+    void *grown = calloc((size_t)newMask + 1, type->slotSize);
+    if (grown == NULL) {
+        return NULL;
+    }
+    for (i = 0; i <= *mask; i++) {
+        if (!type->isEmpty(SLOT(type, slots, i))) {
+            open_hash_place(type, context, grown, newMask, SLOT(type, slots, i));
+        }
+    }
+    free(slots);
+    *mask = newMask;
+    return grown;
+}
+
+void *open_hash_reserve(const struct open_hash_type *type, const void *context, void *slots, uint32_t *mask,
+        uint32_t used) {
+    if (((size_t)used + 1) * 4 > ((size_t)*mask + 1) * type->maxLoadQuarters) {
+        void *grown = open_hash_grow(type, context, slots, mask);
+        if (grown != NULL) {
+            return grown;
+        }
+        if (used >= *mask) {
+            return NULL;
+        }
+    }
+    return slots;
+}
+
+void open_hash_place(const struct open_hash_type *type, const void *context, void *slots, uint32_t mask,
+        const void *slot) {
+    uint32_t pos = type->hash(slot, context) & mask;
+    while (!type->isEmpty(SLOT(type, slots, pos))) {
+        pos = (pos + 1) & mask;
+    }
+    memcpy(SLOT(type, slots, pos), slot, type->slotSize);
+}
+
+void open_hash_remove(const struct open_hash_type *type, const void *context, void *slots, uint32_t mask,
+        uint32_t pos) {
+    uint32_t next = (pos + 1) & mask;
+    while (!type->isEmpty(SLOT(type, slots, next))) {
+        uint32_t home = type->hash(SLOT(type, slots, next), context) & mask;
+        /*move the slot back unless its home lies cyclically in (pos, next]*/
+        if (((next - home) & mask) >= ((next - pos) & mask)) {
+            memcpy(SLOT(type, slots, pos), SLOT(type, slots, next), type->slotSize);
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
+    memset(SLOT(type, slots, pos), 0, type->slotSize);
+}
+
+int open_hash_index_empty(const void *slot) {
+    return *(const uint32_t *)slot == NIL_INDEX;
+}
@@ -0,0 +1,86 @@
+/*
+ * ============================================
+ * file: open_hash.h
+ *
+ * @brief Open addressing with linear probing, shared
+ *        by the hash tables of the service. A table is
+ *        a power of two array of fixed-size slots that
+ *        its owner keeps; a struct open_hash_type tells
+ *        how to hash, compare and recognize the empty
+ *        slots, which are all zero bytes. Deleting shifts
+ *        the later slots of the probe run back, so tables
+ *        need no tombstones.
+ * ============================================
+ */
+
+#ifndef __OPEN_HASH_H__
+#define __OPEN_HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct open_hash_type {
+    size_t slotSize;
+    unsigned maxLoadQuarters;   /* the table doubles before more than this many quarters are used */
+    /* hash of an occupied slot, context being the one given to every call */
+    uint32_t (*hash)(const void *slot, const void *context);
+    /* slot holds key */
+    int (*matches)(const void *slot, const void *key, const void *context);
+    int (*isEmpty)(const void *slot);
+};
+
+/* Hash of a 32-bit key, such as a movie or user ID */
+static inline uint32_t hash_u32(uint32_t key) {
+    uint32_t h = key * 0x9E3779B1u;
+    return h ^ (h >> 16);
+}
+
+/*
+ * Position of the slot holding key, whose hash is hash,
+ * or of the empty slot where it would go
+ */
+static inline uint32_t open_hash_probe(const struct open_hash_type *type, const void *context,
+        const void *slots, uint32_t mask, uint32_t hash, const void *key) {
+    uint32_t pos = hash & mask;
+    for (;;) {
+        const void *slot = (const char *)slots + (size_t)pos * type->slotSize;
+        if (type->isEmpty(slot) || type->matches(slot, key, context)) {
+            return pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+/*
+ * Moves every occupied slot to a new zeroed table of
+ * twice the size and frees the old one.
+ * Returns the new table, with *mask updated, or NULL,
+ * the old table being left as it was
+ */
+void *open_hash_grow(const struct open_hash_type *type, const void *context, void *slots, uint32_t *mask);
+
+/*
+ * Makes room for one more slot when used slots are
+ * occupied, growing the table past its maximum load.
+ * A failed grow only leaves the table more loaded.
+ * Returns the table, possibly a new one with *mask
+ * updated, or NULL if no empty slot would be left
+ */
+void *open_hash_reserve(const struct open_hash_type *type, const void *context, void *slots, uint32_t *mask,
+        uint32_t used);
+
+/* Copies slot into the first empty position of its probe run */
+void open_hash_place(const struct open_hash_type *type, const void *context, void *slots, uint32_t mask,
+        const void *slot);
+
+/*
+ * Empties the slot at pos, shifting back the later
+ * slots of its probe run that may not stay after it
+ */
+void open_hash_remove(const struct open_hash_type *type, const void *context, void *slots, uint32_t mask,
+        uint32_t pos);
+
+/* isEmpty of tables of node pool indices, which hold NIL_INDEX when empty */
+int open_hash_index_empty(const void *slot);
+
+#endif
@@ -0,0 +1,142 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include "perf_counters.h"
+
+/*hardware event of each counter, cache misses being last level ones on most processors*/
+static const uint64_t counterConfigs[PERF_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static int open_counter(uint64_t config, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1; /*allowed at the default perf_event_paranoid level*/
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC);
+}
+
+int perf_counters_open(struct perf_counters *counters) {
+    int i;
+
+    counters->leader = -1;
+    counters->opened = 0;
+    counters->error = 0;
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+        /*the first counter that opens leads the group, the others join it*/
+        counters->fds[i] = open_counter(counterConfigs[i], counters->leader);
+        if (counters->fds[i] < 0) {
+            if (counters->error == 0) {
+                counters->error = errno;
+            }
+            continue;
+        }
+        if (counters->leader < 0) {
+            counters->leader = counters->fds[i];
+        }
+        counters->order[counters->opened++] = i;
+    }
+    return counters->opened;
+}
+
+void perf_counters_close(struct perf_counters *counters) {
+    int i;
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+    counters->leader = -1;
+    counters->opened = 0;
+}
+
+int perf_counters_read(const struct perf_counters *counters, uint64_t values[PERF_COUNTER_COUNT]) {
+    uint64_t group[1 + PERF_COUNTER_COUNT]; /*number of values, then the values in opening order*/
+    int i;
+
+    memset(values, 0, PERF_COUNTER_COUNT * sizeof(uint64_t));
+    if (counters->leader < 0) {
+        return 0;
+    }
+    if (read(counters->leader, group, sizeof(group)) < (ssize_t)sizeof(uint64_t)
+            || group[0] != (uint64_t)counters->opened) {
+        return -1;
+    }
+    for (i = 0; i < counters->opened; i++) {
+        values[counters->order[i]] = group[1 + i];
+    }
+    return 0;
+}
+
+void perf_attribution_init(struct perf_attribution *attribution) {
+    memset(attribution, 0, sizeof(*attribution));
+    perf_counters_open(&attribution->counters);
+}
+
+void perf_attribution_destroy(struct perf_attribution *attribution) {
+    perf_counters_close(&attribution->counters);
+}
+
+void perf_attribution_begin(struct perf_attribution *attribution) {
+    perf_counters_read(&attribution->counters, attribution->start);
+}
+
+void perf_attribution_end(struct perf_attribution *attribution, char type, uint64_t events) {
+    struct perf_event_totals *totals = &attribution->byType[(unsigned char)type % PERF_EVENT_TYPES];
+    uint64_t end[PERF_COUNTER_COUNT];
+    int i;
+
+    totals->events += events;
+    if (perf_counters_read(&attribution->counters, end) != 0) {
+        return;
+    }
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+        totals->values[i] += end[i] - attribution->start[i];
+    }
+}
+
+/*Prints value per event, or n/a when its counter is not open*/
+static void print_ratio(FILE *out, const struct perf_counters *counters, int counter, double value, double per) {
+    if (counters->fds[counter] < 0 || per == 0) {
+        fprintf(out, " %12s", "n/a");
+    } else {
+        fprintf(out, " %12.2f", value / per);
+    }
+}
+
+void perf_attribution_report(const struct perf_attribution *attribution, FILE *out) {
+    const struct perf_counters *counters = &attribution->counters;
+    int type;
+
+    if (counters->opened == 0) {
+        fprintf(out, "Performance counters unavailable (%s), event counts only\n", strerror(counters->error));
+    } else if (counters->opened < PERF_COUNTER_COUNT) {
+        fprintf(out, "Some performance counters unavailable (%s)\n", strerror(counters->error));
+    }
+    fprintf(out, "%-5s %10s %12s %12s %12s %12s %12s\n", "event", "count", "cycles/ev", "instr/ev", "IPC",
+            "LLC miss/ev", "br miss/ev");
+    for (type = 0; type < PERF_EVENT_TYPES; type++) {
+        const struct perf_event_totals *totals = &attribution->byType[type];
+        if (totals->events == 0) {
+            continue;
+        }
+        fprintf(out, "%-5c %10llu", type, (unsigned long long)totals->events);
+        print_ratio(out, counters, PERF_CYCLES, (double)totals->values[PERF_CYCLES], (double)totals->events);
+        print_ratio(out, counters, PERF_INSTRUCTIONS, (double)totals->values[PERF_INSTRUCTIONS], (double)totals->events);
+        print_ratio(out, counters, counters->fds[PERF_CYCLES] < 0 ? PERF_CYCLES : PERF_INSTRUCTIONS,
+                (double)totals->values[PERF_INSTRUCTIONS], (double)totals->values[PERF_CYCLES]);
+        print_ratio(out, counters, PERF_LLC_MISSES, (double)totals->values[PERF_LLC_MISSES], (double)totals->events);
+        print_ratio(out, counters, PERF_BRANCH_MISSES, (double)totals->values[PERF_BRANCH_MISSES], (double)totals->events);
+        fputc('\n', out);
+    }
+}
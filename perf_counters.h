@@ -0,0 +1,87 @@
+/*
+ * ============================================
+ * file: perf_counters.h
+ *
+ * @brief Hardware performance counters of the calling
+ *        thread, opened with perf_event_open, and their
+ *        deltas attributed to the event types of the
+ *        input. Counters the kernel or the container
+ *        refuses are left out; with none at all only
+ *        the event counts are kept.
+ * ============================================
+ */
+
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_COUNTER_COUNT
+} perfCounter_t;
+
+/* event types are the first character of an event line */
+#define PERF_EVENT_TYPES 128
+
+struct perf_counters {
+    int leader;                         /* fd read for the whole group, -1 when nothing opened */
+    int fds[PERF_COUNTER_COUNT];        /* -1 for a counter that could not be opened */
+    int order[PERF_COUNTER_COUNT];      /* counter of each value of a group read */
+    int opened;
+    int error;                          /* errno of the first counter refused */
+};
+
+struct perf_event_totals {
+    uint64_t events;
+    uint64_t values[PERF_COUNTER_COUNT];
+};
+
+struct perf_attribution {
+    struct perf_counters counters;
+    uint64_t start[PERF_COUNTER_COUNT]; /* values read by perf_attribution_begin */
+    struct perf_event_totals byType[PERF_EVENT_TYPES];
+};
+
+/*
+ * Opens every counter it can for the calling thread,
+ * user space only, and starts them.
+ * Returns the number of counters opened
+ */
+int perf_counters_open(struct perf_counters *counters);
+
+/* Closes the counters */
+void perf_counters_close(struct perf_counters *counters);
+
+/*
+ * Reads every opened counter into values, in one read of
+ * the group. Counters not opened read 0.
+ * Returns 0 on success, -1 on failure
+ */
+int perf_counters_read(const struct perf_counters *counters, uint64_t values[PERF_COUNTER_COUNT]);
+
+/* Opens the counters of the calling thread and clears every total */
+void perf_attribution_init(struct perf_attribution *attribution);
+
+/* Releases the counters, totals are kept */
+void perf_attribution_destroy(struct perf_attribution *attribution);
+
+/* Snapshots the counters before events are dispatched */
+void perf_attribution_begin(struct perf_attribution *attribution);
+
+/* Adds the deltas since perf_attribution_begin to event type type, for events events */
+void perf_attribution_end(struct perf_attribution *attribution, char type, uint64_t events);
+
+/*
+ * Prints, per event type seen, the number of events,
+ * cycles and instructions per event, IPC, LLC and
+ * branch misses per event. Counters that could not be
+ * opened are reported as n/a
+ */
+void perf_attribution_report(const struct perf_attribution *attribution, FILE *out);
+
+#endif
@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "replay.h"
+
+/*files of one worker, taken from the front by their owner and stolen from the back by the others*/
+struct replay_deque {
+    pthread_mutex_t lock;
+    int *files;                 /* indices into the paths */
+    int head, tail;
+};
+
+struct replay_driver {
+    char *const *paths;
+    const struct replay_config *config;
+    struct replay_deque *deques;
+    int workers;
+    _Atomic uint64_t events;
+    _Atomic int failed;
+    _Atomic int stolen;
+};
+
+struct replay_worker {
+    pthread_t thread;
+    int id;
+    struct replay_driver *driver;
+};
+
+/*an input file and its size, to deal the largest files first*/
+struct replay_input {
+    int file;
+    off_t size;
+};
+
+static int input_larger(const void *a, const void *b) {
+    const struct replay_input *x = (const struct replay_input *)a, *y = (const struct replay_input *)b;
+    if (x->size != y->size) {
+        return x->size < y->size ? 1 : -1;
+    }
+    return x->file - y->file;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*Next file of the owner's own deque, -1 once it is empty*/
+static int deque_take(struct replay_deque *deque) {
+    int file = -1;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        file = deque->files[deque->head++];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return file;
+}
+
+/*Last file of another worker's deque, -1 if it is empty*/
+static int deque_steal(struct replay_deque *deque) {
+    int file = -1;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        file = deque->files[--deque->tail];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return file;
+}
+
+/*Replay one input file into its output file*/
+static void replay_file(struct replay_driver *driver, int file) {
+    const char *path = driver->paths[file];
+    char *outPath = (char *)malloc(strlen(path) + sizeof(REPLAY_OUT_SUFFIX));
+    char reason[128];
+    FILE *in = NULL, *out = NULL;
+    long events = -1;
+
+    if (outPath == NULL) {
+        fprintf(stderr, "Could not allocate memory for %s\n", path);
+        atomic_fetch_add(&driver->failed, 1);
+        return;
+    }
+    strcpy(outPath, path);
+    strcat(outPath, REPLAY_OUT_SUFFIX);
+
+    in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Could not open %s: %s\n", path, strerror_r(errno, reason, sizeof(reason)));
+    } else if ((out = fopen(outPath, "w")) == NULL) {
+        fprintf(stderr, "Could not create %s: %s\n", outPath, strerror_r(errno, reason, sizeof(reason)));
+    } else {
+        setvbuf(out, NULL, _IOFBF, REPLAY_OUT_BUFFER);
+        events = driver->config->replay(driver->config->context, in, out);
+        if (fclose(out) != 0) {
+            fprintf(stderr, "Could not write %s: %s\n", outPath, strerror_r(errno, reason, sizeof(reason)));
+            events = -1;
+        }
+    }
+    if (in != NULL) {
+        fclose(in);
+    }
+    free(outPath);
+
+    if (events < 0) {
+        fprintf(stderr, "Replay of %s failed\n", path);
+        atomic_fetch_add(&driver->failed, 1);
+    } else {
+        atomic_fetch_add(&driver->events, (uint64_t)events);
+    }
+}
+
+/*Replay the worker's own files, then steal from the others until every deque is empty*/
+static void *worker_main(void *arg) {
+    struct replay_worker *worker = (struct replay_worker *)arg;
+    struct replay_driver *driver = worker->driver;
+
+    for (;;) {
+        int file = deque_take(&driver->deques[worker->id]);
+        int victim;
+        /*no file is ever added, so empty deques stay empty*/
+        for (victim = 1; file < 0 && victim < driver->workers; victim++) {
+            file = deque_steal(&driver->deques[(worker->id + victim) % driver->workers]);
+            if (file >= 0) {
+                atomic_fetch_add(&driver->stolen, 1);
+            }
+        }
+        if (file < 0) {
+            break;
+        }
+        replay_file(driver, file);
+    }
+    return NULL;
+}
+
+int run_replay(char *const *paths, int count, const struct replay_config *config) {
+    struct replay_driver driver;
+    struct replay_worker *workers;
+    struct replay_input *inputs;
+    int *files;
+    int threads = config->threads, started, offset, i;
+    double start, elapsed;
+
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int)online : 1;
+    }
+    if (threads > count) {
+        threads = count > 0 ? count : 1;
+    }
+
+    memset(&driver, 0, sizeof(driver));
+    driver.paths = paths;
+    driver.config = config;
+    driver.workers = threads;
+    driver.deques = (struct replay_deque *)calloc((size_t)threads, sizeof(struct replay_deque));
+    workers = (struct replay_worker *)calloc((size_t)threads, sizeof(struct replay_worker));
+    inputs = (struct replay_input *)malloc((count ? count : 1) * sizeof(struct replay_input));
+    files = (int *)malloc((count ? count : 1) * sizeof(int));
+    if (driver.deques == NULL || workers == NULL || inputs == NULL || files == NULL) {
+        fprintf(stderr, "Could not allocate memory for the replay\n");
+        free(driver.deques);
+        free(workers);
+        free(inputs);
+        free(files);
+        return -1;
+    }
+
+    /*Deal the files largest first, so that every worker starts with a fair share of the work*/
+    for (i = 0; i < count; i++) {
+        struct stat info;
+        inputs[i].file = i;
+        inputs[i].size = stat(paths[i], &info) == 0 ? info.st_size : 0;
+    }
+    qsort(inputs, (size_t)count, sizeof(struct replay_input), input_larger);
+    for (i = 0, offset = 0; i < threads; i++) {
+        pthread_mutex_init(&driver.deques[i].lock, NULL);
+        driver.deques[i].files = files + offset;
+        offset += (count - i + threads - 1) / threads; /*files dealt to worker i*/
+    }
+    for (i = 0; i < count; i++) {
+        struct replay_deque *deque = &driver.deques[i % threads];
+        deque->files[deque->tail++] = inputs[i].file;
+    }
+
+    /*The calling thread is worker 0, the files of workers that fail to start get stolen*/
+    start = now_seconds();
+    for (i = 0; i < threads; i++) {
+        workers[i].id = i;
+        workers[i].driver = &driver;
+    }
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+            fprintf(stderr, "Replay started %d of %d threads\n", started, threads);
+            break;
+        }
+    }
+    worker_main(&workers[0]);
+    for (i = 1; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    elapsed = now_seconds() - start;
+
+    fprintf(stderr, "Replayed %d of %d files on %d threads, %d stolen\n", count - driver.failed, count, started,
+            driver.stolen);
+    fprintf(stderr, "%llu events in %.3f s, %.0f events/s\n", (unsigned long long)driver.events, elapsed,
+            elapsed > 0 ? driver.events / elapsed : 0.0);
+
+    for (i = 0; i < threads; i++) {
+        pthread_mutex_destroy(&driver.deques[i].lock);
+    }
+    free(driver.deques);
+    free(workers);
+    free(inputs);
+    free(files);
+    return driver.failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,51 @@
+/*
+ * ============================================
+ * file: replay.h
+ *
+ * @brief Replay driver. Many independent event files
+ *        are replayed at the same time on a pool of
+ *        worker threads, each file on state of its own
+ *        and into a buffered output file of its own.
+ *        Every worker starts with a share of the files
+ *        and, once out of them, steals files not started
+ *        yet from the other workers.
+ * ============================================
+ */
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdio.h>
+
+/* appended to an input path to name its output file */
+#define REPLAY_OUT_SUFFIX ".out"
+
+/* buffer of each output file, in bytes */
+#define REPLAY_OUT_BUFFER (1 << 20)
+
+/*
+ * Replays the events of in on fresh state, writing
+ * their output to out. Called on worker threads, at
+ * the same time for different files.
+ * Returns the number of events replayed, -1 on failure
+ */
+typedef long (*replay_handler_t)(void *context, FILE *in, FILE *out);
+
+struct replay_config {
+    int threads;                /* worker threads, 0 for one per online processor */
+    replay_handler_t replay;
+    void *context;              /* passed to replay */
+};
+
+/*
+ * Replays each of the count files of paths through
+ * config->replay into the file of the same path
+ * followed by REPLAY_OUT_SUFFIX, then reports the
+ * files, events, time and aggregate events per second
+ * to stderr.
+ *
+ * Returns 0 if every file was replayed, -1 otherwise
+ */
+int run_replay(char *const *paths, int count, const struct replay_config *config);
+
+#endif
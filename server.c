@@ -0,0 +1,725 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include "server.h"
+
+/*maximum number of epoll events handled per wakeup*/
+#define SERVER_MAX_EVENTS 64
+
+/*pending connections queued by the kernel*/
+#define SERVER_BACKLOG 128
+
+struct client {
+    int fd;
+    int readOpen;               /* the client may still send lines */
+    int broken;                 /* a write failed, output is dropped */
+    int pending;                /* lines of this client waiting in the batch */
+    char in[SERVER_MAX_LINE];   /* partial line received so far */
+    size_t inLen;
+    int skipping;               /* dropping the rest of an overlong line */
+    char *out;                  /* results not yet written to the socket */
+    size_t outLen, outSent, outCap;
+    uint32_t watched;           /* epoll events the socket is registered for */
+    struct client *next;
+};
+
+/*a line answered, or prefetched, on a reader thread*/
+struct read_job {
+    void *snapshot;
+    FILE *out;                  /* memory stream filling text */
+    char *text;
+    size_t len;
+    void *work;                 /* prefetched work instead of a snapshot to answer */
+    int done;                   /* the work is done, under the pool lock */
+    struct read_job *next;
+};
+
+/*a received line waiting for the batch to run*/
+struct pending_line {
+    struct client *client;
+    size_t offset;              /* position of the line in the batch text */
+    void *work;                 /* prefetched for the line, NULL if none */
+    struct read_job *job;       /* doing work, NULL once it is done */
+};
+
+/*output of one client within a batch, once a reader answers out of order*/
+struct batch_segment {
+    struct client *client;
+    struct read_job *job;       /* NULL for output of lines run on the server thread */
+    char *text;
+    size_t len, cap;
+};
+
+struct reader_pool {
+    pthread_t *threads;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t work, idle, done;
+    struct read_job *head, *tail;
+    size_t unfinished;          /* submitted reads not completed yet */
+    int stopping;
+    snapshot_read_t read;
+    prefetch_run_t run;
+};
+
+struct server {
+    int epollFd, listenFd, timerFd, captureFd;
+    const struct server_config *config;
+    struct client *clients;
+    struct pending_line *lines;
+    size_t lineCount, lineCap;
+    char *text;                 /* NUL separated lines of the batch */
+    size_t textLen, textCap;
+    struct reader_pool readers;
+    struct batch_segment *segments;  /* empty until a reader gets a line of the batch */
+    size_t segmentCount, segmentCap;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void request_stop(int signo) {
+    (void)signo;
+    stopRequested = 1;
+}
+
+/*Grow buffer *buf of capacity *cap to hold at least need bytes*/
+static int reserve(char **buf, size_t *cap, size_t need) {
+    size_t newCap = *cap ? *cap : 256;
+    char *grown;
+    if (need <= *cap) {
+        return 0;
+    }
+    while (newCap < need) {
+        newCap *= 2;
+    }
+    grown = (char *)realloc(*buf, newCap);
+    if (grown == NULL) {
+        return -1;
+    }
+    *buf = grown;
+    *cap = newCap;
+    return 0;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/*Queue one complete line of client for the next batch, starting the window if the batch was empty*/
+static int queue_line(struct server *srv, struct client *client, const char *line, size_t len) {
+    if (srv->lineCount == srv->lineCap) {
+        size_t newCap = srv->lineCap ? srv->lineCap * 2 : 64;
+        struct pending_line *grown = (struct pending_line *)realloc(srv->lines, newCap * sizeof(*grown));
+        if (grown == NULL) {
+            return -1;
+        }
+        srv->lines = grown;
+        srv->lineCap = newCap;
+    }
+    if (reserve(&srv->text, &srv->textCap, srv->textLen + len + 2) != 0) {
+        return -1;
+    }
+    srv->lines[srv->lineCount].client = client;
+    srv->lines[srv->lineCount].offset = srv->textLen;
+    srv->lines[srv->lineCount].work = NULL;
+    srv->lines[srv->lineCount].job = NULL;
+    memcpy(srv->text + srv->textLen, line, len);
+    srv->text[srv->textLen + len] = '\n';
+    srv->text[srv->textLen + len + 1] = '\0';
+    srv->textLen += len + 2;
+    client->pending++;
+
+    if (srv->lineCount++ == 0) {
+        struct itimerspec window;
+        memset(&window, 0, sizeof(window));
+        window.it_value.tv_sec = srv->config->windowUs / 1000000;
+        window.it_value.tv_nsec = (srv->config->windowUs % 1000000) * 1000;
+        if (window.it_value.tv_sec == 0 && window.it_value.tv_nsec == 0) {
+            window.it_value.tv_nsec = 1; /*a zero value would disarm the timer*/
+        }
+        timerfd_settime(srv->timerFd, 0, &window, NULL);
+    }
+    return 0;
+}
+
+/*Read what the client sent and queue its complete lines*/
+static void client_read(struct server *srv, struct client *client) {
+    char chunk[4096];
+    for (;;) {
+        ssize_t got = read(client->fd, chunk, sizeof(chunk));
+        ssize_t i;
+        if (got == 0) {
+            client->readOpen = 0;
+            break;
+        }
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                client->readOpen = 0;
+                client->broken = 1;
+            }
+            break;
+        }
+        for (i = 0; i < got; i++) {
+            if (chunk[i] == '\n') {
+                if (!client->skipping && queue_line(srv, client, client->in, client->inLen) != 0) {
+                    fprintf(stderr, "Server could not queue an event line\n");
+                }
+                client->inLen = 0;
+                client->skipping = 0;
+            } else if (client->skipping) {
+                continue;
+            } else if (client->inLen == SERVER_MAX_LINE - 1) {
+                fprintf(stderr, "Server dropped an event line longer than %d bytes\n", SERVER_MAX_LINE - 1);
+                client->inLen = 0;
+                client->skipping = 1;
+            } else {
+                client->in[client->inLen++] = chunk[i];
+            }
+        }
+    }
+}
+
+/*Register the client for reading while it may send, and for writing while output is left*/
+static void client_watch(struct server *srv, struct client *client) {
+    uint32_t watched = (client->readOpen ? EPOLLIN : 0) | (client->outLen > 0 ? EPOLLOUT : 0);
+    if (watched != client->watched) {
+        struct epoll_event ev;
+        ev.events = watched;
+        ev.data.ptr = client;
+        epoll_ctl(srv->epollFd, EPOLL_CTL_MOD, client->fd, &ev);
+        client->watched = watched;
+    }
+}
+
+/*Write as much pending output as the socket takes, asking for EPOLLOUT if some is left*/
+static void client_flush(struct server *srv, struct client *client) {
+    while (!client->broken && client->outSent < client->outLen) {
+        ssize_t sent = send(client->fd, client->out + client->outSent, client->outLen - client->outSent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                client->broken = 1;
+            }
+            break;
+        }
+        client->outSent += sent;
+    }
+    if (client->broken || client->outSent == client->outLen) {
+        client->outLen = client->outSent = 0;
+    }
+    client_watch(srv, client);
+}
+
+/*Move everything the events wrote to stdout since the last call into the client's output,
+  or into the last segment of the batch once a reader answers one of its lines*/
+static void collect_output(struct server *srv, struct client *client) {
+    char **buf = &client->out;
+    size_t *len = &client->outLen, *cap = &client->outCap;
+    off_t captured;
+    fflush(stdout);
+    captured = lseek(srv->captureFd, 0, SEEK_CUR);
+    if (captured <= 0) {
+        return;
+    }
+    if (srv->segmentCount > 0) {
+        struct batch_segment *segment = &srv->segments[srv->segmentCount - 1];
+        buf = &segment->text;
+        len = &segment->len;
+        cap = &segment->cap;
+    }
+    if (!client->broken && reserve(buf, cap, *len + (size_t)captured) == 0
+            && pread(srv->captureFd, *buf + *len, (size_t)captured, 0) == captured) {
+        *len += (size_t)captured;
+    }
+    if (ftruncate(srv->captureFd, 0) != 0) {
+        perror("ftruncate error for server output capture");
+    }
+    lseek(srv->captureFd, 0, SEEK_SET);
+}
+
+static void *reader_main(void *arg) {
+    struct reader_pool *pool = (struct reader_pool *)arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        struct read_job *job;
+        while (pool->head == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->head == NULL) {
+            break;
+        }
+        job = pool->head;
+        pool->head = job->next;
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        if (job->work != NULL) {
+            pool->run(job->work);
+        } else {
+            pool->read(job->snapshot, job->out);
+            fclose(job->out);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (job->work != NULL) {
+            job->done = 1; /*the server thread owns the job from here on*/
+            pthread_cond_broadcast(&pool->done);
+        } else if (--pool->unfinished == 0) {
+            pthread_cond_signal(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*Start up to count reader threads, the pool stays empty if none could be started*/
+static void readers_start(struct reader_pool *pool, int count, snapshot_read_t read, prefetch_run_t run) {
+    memset(pool, 0, sizeof(*pool));
+    if (count <= 0 || read == NULL) {
+        return;
+    }
+    pool->threads = (pthread_t *)malloc((size_t)count * sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        return;
+    }
+    pool->read = read;
+    pool->run = run;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    while (pool->count < count && pthread_create(&pool->threads[pool->count], NULL, reader_main, pool) == 0) {
+        pool->count++;
+    }
+    if (pool->count < count) {
+        fprintf(stderr, "Server started %d of %d reader threads\n", pool->count, count);
+    }
+}
+
+static void readers_stop(struct reader_pool *pool) {
+    int i;
+    if (pool->threads == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    pool->threads = NULL;
+    pool->count = 0;
+}
+
+/*Open a new segment of client's output at the end of the batch*/
+static struct batch_segment *add_segment(struct server *srv, struct client *client, struct read_job *job) {
+    struct batch_segment *segment;
+    if (srv->segmentCount == srv->segmentCap) {
+        size_t newCap = srv->segmentCap ? srv->segmentCap * 2 : 16;
+        struct batch_segment *grown = (struct batch_segment *)realloc(srv->segments, newCap * sizeof(*grown));
+        if (grown == NULL) {
+            return NULL;
+        }
+        memset(grown + srv->segmentCap, 0, (newCap - srv->segmentCap) * sizeof(*grown));
+        srv->segments = grown;
+        srv->segmentCap = newCap;
+    }
+    segment = &srv->segments[srv->segmentCount++];
+    segment->client = client;
+    segment->job = job;
+    segment->len = 0;
+    return segment;
+}
+
+/*Wait for the readers, then hand every segment to its client in batch order*/
+static void finish_reads(struct server *srv) {
+    struct reader_pool *pool = &srv->readers;
+    size_t i;
+    if (srv->segmentCount == 0) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (pool->unfinished > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < srv->segmentCount; i++) {
+        struct batch_segment *segment = &srv->segments[i];
+        struct client *client = segment->client;
+        const char *text = segment->job != NULL ? segment->job->text : segment->text;
+        size_t len = segment->job != NULL ? segment->job->len : segment->len;
+        if (len > 0 && !client->broken && reserve(&client->out, &client->outCap, client->outLen + len) == 0) {
+            memcpy(client->out + client->outLen, text, len);
+            client->outLen += len;
+        }
+        if (segment->job != NULL) {
+            free(segment->job->text);
+            free(segment->job);
+            segment->job = NULL;
+        }
+    }
+    srv->segmentCount = 0;
+}
+
+/*Queue a job for the readers, reads counting as unfinished until answered*/
+static void readers_push(struct reader_pool *pool, struct read_job *job) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail != NULL) {
+        pool->tail->next = job;
+    } else {
+        pool->head = job;
+    }
+    pool->tail = job;
+    if (job->work == NULL) {
+        pool->unfinished++;
+    }
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*Hand a pinned line of client to the readers, returns -1 if it has to be answered here*/
+static int submit_read(struct server *srv, struct client *client, void *snapshot) {
+    struct reader_pool *pool = &srv->readers;
+    struct read_job *job = (struct read_job *)calloc(1, sizeof(*job));
+    if (job == NULL) {
+        return -1;
+    }
+    job->snapshot = snapshot;
+    job->out = open_memstream(&job->text, &job->len);
+    if (job->out == NULL || add_segment(srv, client, job) == NULL) {
+        if (job->out != NULL) {
+            fclose(job->out);
+            free(job->text);
+        }
+        free(job);
+        return -1;
+    }
+    readers_push(pool, job);
+    return 0;
+}
+
+/*Hand the readers the work found in the lines of the batch, before any of them runs*/
+static void prefetch_batch(struct server *srv) {
+    const struct server_config *config = srv->config;
+    size_t i;
+    for (i = 0; i < srv->lineCount; i++) {
+        struct pending_line *line = &srv->lines[i];
+        line->work = config->prefetch(config->context, srv->text + line->offset);
+        if (line->work == NULL) {
+            continue;
+        }
+        line->job = (struct read_job *)calloc(1, sizeof(*line->job));
+        if (line->job == NULL) {
+            config->runPrefetch(line->work); /*no job to hand over, do the work here*/
+            continue;
+        }
+        line->job->work = line->work;
+        readers_push(&srv->readers, line->job);
+    }
+}
+
+/*Wait until the readers are done with the work of line*/
+static void prefetch_wait(struct server *srv, struct pending_line *line) {
+    struct reader_pool *pool = &srv->readers;
+    if (line->job == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    while (!line->job->done) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    free(line->job);
+    line->job = NULL;
+}
+
+/*Execute the batched lines in arrival order, stdout pointing at the capture file meanwhile.
+  Lines the readers take are answered concurrently with the lines that follow them,
+  and the work prefetched for the batch runs ahead of the lines that wait for it*/
+static void run_batch(struct server *srv) {
+    const struct server_config *config = srv->config;
+    struct client *owner = NULL, *client;
+    int savedStdout;
+    size_t i;
+
+    fflush(stdout);
+    savedStdout = dup(STDOUT_FILENO);
+    if (savedStdout < 0 || dup2(srv->captureFd, STDOUT_FILENO) < 0) {
+        perror("dup error for server output capture");
+        if (savedStdout >= 0) {
+            close(savedStdout);
+        }
+        return;
+    }
+
+    if (srv->readers.count > 0 && config->prefetch != NULL) {
+        prefetch_batch(srv);
+    }
+    for (i = 0; i < srv->lineCount; i++) {
+        struct pending_line *line = &srv->lines[i];
+        void *snapshot = srv->readers.count > 0 && line->work == NULL
+                ? config->pin(config->context, srv->text + line->offset) : NULL;
+
+        if (snapshot != NULL) {
+            if (owner != NULL) {
+                collect_output(srv, owner);
+                owner = NULL;
+            }
+            if (submit_read(srv, line->client, snapshot) == 0) {
+                line->client->pending--;
+                continue;
+            }
+        }
+        if (owner != line->client) {
+            if (owner != NULL) {
+                collect_output(srv, owner);
+            }
+            if (srv->segmentCount > 0 && add_segment(srv, line->client, NULL) == NULL) {
+                finish_reads(srv); /*no room to keep the order, settle what the readers hold first*/
+            }
+            owner = line->client;
+        }
+        if (snapshot != NULL) {
+            config->read(snapshot, stdout);
+        } else if (line->work != NULL) {
+            prefetch_wait(srv, line);
+            config->handlePrefetched(config->context, srv->text + line->offset, line->work);
+            line->work = NULL;
+        } else {
+            config->handle(config->context, srv->text + line->offset);
+        }
+        line->client->pending--;
+    }
+    if (owner != NULL) {
+        collect_output(srv, owner);
+    }
+    finish_reads(srv);
+
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    srv->lineCount = 0;
+    srv->textLen = 0;
+
+    for (client = srv->clients; client != NULL; client = client->next) {
+        client_flush(srv, client);
+    }
+}
+
+/*Close clients that are done: nothing more to read, nothing queued, nothing left to write*/
+static void reap_clients(struct server *srv) {
+    struct client **link = &srv->clients;
+    while (*link != NULL) {
+        struct client *client = *link;
+        if (client->pending == 0 && (client->broken || (!client->readOpen && client->outLen == 0))) {
+            *link = client->next;
+            epoll_ctl(srv->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+            close(client->fd);
+            free(client->out);
+            free(client);
+        } else {
+            link = &client->next;
+        }
+    }
+}
+
+static void accept_clients(struct server *srv) {
+    for (;;) {
+        struct epoll_event ev;
+        struct client *client;
+        int fd = accept(srv->listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break; /*EAGAIN once the queue is drained*/
+        }
+        client = (struct client *)calloc(1, sizeof(*client));
+        if (client == NULL || set_nonblocking(fd) != 0) {
+            free(client);
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->readOpen = 1;
+        client->watched = EPOLLIN;
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+        if (epoll_ctl(srv->epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            free(client);
+            close(fd);
+            continue;
+        }
+        client->next = srv->clients;
+        srv->clients = client;
+    }
+}
+
+static int open_listener(const char *socketPath) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket error for server");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+    unlink(socketPath);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+        perror("bind/listen error for server socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int run_server(const char *socketPath, const struct server_config *config) {
+    struct server srv;
+    struct server_config settings = *config;
+    struct epoll_event ev, events[SERVER_MAX_EVENTS];
+    struct sigaction stop;
+    int status = 0;
+    size_t seg;
+
+    memset(&srv, 0, sizeof(srv));
+    if (settings.windowUs < 0) {
+        settings.windowUs = 0;
+    }
+    if (settings.pin == NULL) {
+        settings.readers = 0;
+    }
+    if (settings.runPrefetch == NULL || settings.handlePrefetched == NULL) {
+        settings.prefetch = NULL;
+    }
+    srv.config = &settings;
+    srv.epollFd = srv.timerFd = srv.captureFd = -1;
+    srv.listenFd = open_listener(socketPath);
+    if (srv.listenFd < 0) {
+        return -1;
+    }
+    srv.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    srv.timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    srv.captureFd = memfd_create("event_output", MFD_CLOEXEC);
+    if (srv.epollFd < 0 || srv.timerFd < 0 || srv.captureFd < 0) {
+        perror("server setup error");
+        status = -1;
+        goto cleanup;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = &srv.listenFd;
+    epoll_ctl(srv.epollFd, EPOLL_CTL_ADD, srv.listenFd, &ev);
+    ev.data.ptr = &srv.timerFd;
+    epoll_ctl(srv.epollFd, EPOLL_CTL_ADD, srv.timerFd, &ev);
+
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = request_stop;
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    readers_start(&srv.readers, settings.readers, settings.read, settings.runPrefetch);
+    fprintf(stderr, "Listening on %s\n", socketPath);
+
+    while (!stopRequested) {
+        int n = epoll_wait(srv.epollFd, events, SERVER_MAX_EVENTS, -1);
+        int i;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait error");
+            status = -1;
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (events[i].data.ptr == &srv.listenFd) {
+                accept_clients(&srv);
+            } else if (events[i].data.ptr == &srv.timerFd) {
+                uint64_t expirations;
+                if (read(srv.timerFd, &expirations, sizeof(expirations)) > 0 && srv.lineCount > 0) {
+                    run_batch(&srv);
+                }
+            } else {
+                struct client *client = (struct client *)events[i].data.ptr;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    client_read(&srv, client);
+                }
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    client->readOpen = 0;
+                    client->broken = 1; /*gone for good, nobody is left to read its results*/
+                } else if (events[i].events & EPOLLOUT) {
+                    client_flush(&srv, client);
+                }
+                client_watch(&srv, client);
+            }
+        }
+        /*Clients that closed their side still get the results of their last lines first*/
+        if (srv.lineCount == 0) {
+            reap_clients(&srv);
+        }
+    }
+
+    /*Run what is already queued before shutting down*/
+    if (srv.lineCount > 0) {
+        run_batch(&srv);
+    }
+
+cleanup:
+    readers_stop(&srv.readers);
+    for (seg = 0; seg < srv.segmentCap; seg++) {
+        free(srv.segments[seg].text);
+    }
+    free(srv.segments);
+    while (srv.clients != NULL) {
+        struct client *client = srv.clients;
+        srv.clients = client->next;
+        close(client->fd);
+        free(client->out);
+        free(client);
+    }
+    free(srv.lines);
+    free(srv.text);
+    if (srv.captureFd >= 0) {
+        close(srv.captureFd);
+    }
+    if (srv.timerFd >= 0) {
+        close(srv.timerFd);
+    }
+    if (srv.epollFd >= 0) {
+        close(srv.epollFd);
+    }
+    close(srv.listenFd);
+    unlink(socketPath);
+    return status;
+}
@@ -0,0 +1,85 @@
+/*
+ * ============================================
+ * file: server.h
+ *
+ * @brief Server mode. Local clients connect to a Unix
+ *        domain socket and send event lines in the same
+ *        text format as the input files. Lines arriving
+ *        within a short window are executed together, in
+ *        arrival order, and the output of each event is
+ *        streamed back to the client that sent it.
+ * ============================================
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <stdio.h>
+
+/* default batching window, in microseconds */
+#define SERVER_DEFAULT_WINDOW_US 1000
+
+/* longest accepted event line, longer lines are dropped */
+#define SERVER_MAX_LINE 1024
+
+/* executes one event line on context, returns -1 if it holds no event */
+typedef int (*event_handler_t)(void *context, char *line);
+
+/*
+ * Called on the server thread, in batch order. Returns a
+ * pinned snapshot if line only reads snapshot protected
+ * state, NULL if it has to go through the event handler
+ */
+typedef void *(*snapshot_pin_t)(void *context, const char *line);
+
+/* answers a pinned line to out and releases its snapshot, on any thread */
+typedef void (*snapshot_read_t)(void *snapshot, FILE *out);
+
+/*
+ * Called on the server thread for every line of a batch,
+ * in batch order, before the batch runs. Returns work a
+ * reader thread can do ahead of line, NULL if there is
+ * none
+ */
+typedef void *(*prefetch_t)(void *context, const char *line);
+
+/* does prefetched work, on a reader thread */
+typedef void (*prefetch_run_t)(void *work);
+
+/*
+ * Executes a prefetched line on context once its work is
+ * done, then releases the work. Returns like
+ * event_handler_t
+ */
+typedef int (*prefetched_handler_t)(void *context, char *line, void *work);
+
+struct server_config {
+    long windowUs;              /* batching window, in microseconds */
+    int readers;                /* reader threads, 0 runs every line on the server thread */
+    event_handler_t handle;
+    snapshot_pin_t pin;         /* may be NULL when readers is 0 */
+    snapshot_read_t read;
+    prefetch_t prefetch;        /* may be NULL, ignored when readers is 0 */
+    prefetch_run_t runPrefetch;
+    prefetched_handler_t handlePrefetched;
+    void *context;              /* passed to handle, pin, prefetch and handlePrefetched */
+};
+
+/*
+ * Listens on socketPath until SIGINT or SIGTERM,
+ * running every received line through config->handle.
+ * Lines are batched for config->windowUs microseconds
+ * after the first line of a batch arrives. Lines that
+ * config->pin accepts are answered by reader threads
+ * while the following lines of the batch run; results
+ * still reach each client in the order it sent them.
+ * The work config->prefetch finds in the lines of a
+ * batch is handed to the reader threads before the
+ * batch runs, each line waiting for its own work only
+ * when its turn comes.
+ *
+ * Returns 0 on a clean shutdown, -1 on failure
+ */
+int run_server(const char *socketPath, const struct server_config *config);
+
+#endif
@@ -0,0 +1,118 @@
+#include "streaming_service.h"
+
+/*
+ * Compatibility wrappers, each forwarding to its
+ * service_ counterpart on defaultService
+ */
+struct streaming_service defaultService;
+
+/*the built-in category table was loaded by init_structures, destroy_structures releases it*/
+static int loadedCategoryNames;
+
+void init_structures(void) {
+    /*Callers of the old API never load a category table, D would drop every movie without one*/
+    if (defaultService.categoryCount == 0 && service_load_category_names(&defaultService, NULL) == 0) {
+        loadedCategoryNames = 1;
+    }
+    service_init_structures(&defaultService);
+}
+
+void destroy_structures(void) {
+    service_destroy_structures(&defaultService);
+    if (loadedCategoryNames) {
+        service_free_category_names(&defaultService);
+        loadedCategoryNames = 0;
+    }
+}
+
+int register_user(int uid) {
+    return service_register_user(&defaultService, uid);
+}
+
+void unregister_user(int uid) {
+    service_unregister_user(&defaultService, uid);
+}
+
+int add_new_movie(unsigned mid, movieCategory_t category, unsigned year) {
+    return service_add_new_movie(&defaultService, mid, category, year);
+}
+
+void distribute_new_movies(void) {
+    service_distribute_new_movies(&defaultService);
+}
+
+int watch_movie(int uid, unsigned mid) {
+    return service_watch_movie(&defaultService, uid, mid);
+}
+
+int suggest_movies(int uid) {
+    return service_suggest_movies(&defaultService, uid);
+}
+
+int filtered_movie_search(int uid, movieCategory_t category1, movieCategory_t category2, unsigned year) {
+    return service_filtered_movie_search(&defaultService, uid, category1, category2, year);
+}
+
+int multi_category_search(int uid, const int *categories, unsigned count, unsigned year) {
+    return service_multi_category_search(&defaultService, uid, categories, count, year);
+}
+
+int cowatch_suggest_movies(int uid, unsigned n) {
+    return service_cowatch_suggest_movies(&defaultService, uid, n);
+}
+
+void take_off_movie(unsigned mid) {
+    service_take_off_movie(&defaultService, mid);
+}
+
+void take_off_movies(const unsigned *mids, unsigned count) {
+    service_take_off_movies(&defaultService, mids, count);
+}
+
+int most_watched_movies(unsigned k, int category) {
+    return service_most_watched_movies(&defaultService, k, category);
+}
+
+void print_memory(void) {
+    service_print_memory(&defaultService);
+}
+
+void print_memory_usage(FILE *out) {
+    service_print_memory_usage(&defaultService, out);
+}
+
+int load_category_names(const char *path) {
+    return service_load_category_names(&defaultService, path);
+}
+
+void free_category_names(void) {
+    service_free_category_names(&defaultService);
+}
+
+const char *get_category_name(int category) {
+    return service_get_category_name(&defaultService, category);
+}
+
+const struct category_lists *current_category_lists(void) {
+    return service_current_category_lists(&defaultService);
+}
+
+int category_snapshot_pin(struct category_snapshot *snapshot) {
+    return service_category_snapshot_pin(&defaultService, snapshot);
+}
+
+void category_snapshot_unpin(struct category_snapshot *snapshot) {
+    service_category_snapshot_unpin(&defaultService, snapshot);
+}
+
+void print_movies_snapshot(const struct category_lists *lists, FILE *out) {
+    service_print_movies_snapshot(&defaultService, lists, out);
+}
+
+void print_movies(void) {
+    service_print_movies(&defaultService);
+}
+
+void print_users(void) {
+    service_print_users(&defaultService);
+}
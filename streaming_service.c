@@ -2,253 +2,555 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include "open_hash.h"
 #include "streaming_service.h"
 
+void service_init_structures(struct streaming_service *service) {
+    int i;
+
+    if (service->out == NULL) {
+        service->out = stdout;
+    }
+    mem_stats_init(&service->memStats);
+
+    /*Initialize the node pools and the movie catalog*/
+    if (node_pool_init(&service->moviePool, sizeof(struct movie)) != 0
+            || node_pool_init(&service->suggestedPool, sizeof(struct suggested_movie)) != 0
+            || movie_catalog_init(&service->movieCatalog) != 0
+            || user_table_init(&service->userTable) != 0
+            || watch_stats_init(&service->watchStats, service->categoryCount) != 0
+            || cowatch_init(&service->coWatch, service->cowatchCells ? service->cowatchCells : COWATCH_DEFAULT_MAX_CELLS) != 0) {
+        fprintf(stderr, "Could not allocate node pools\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /*Initialize category-specific and new movies lists*/
+    service->newMoviesList = NULL;
+    struct category_lists *lists = (struct category_lists *)malloc(CATEGORY_LISTS_SIZE(service->categoryCount));
+    if (lists == NULL) {
+        fprintf(stderr, "Could not allocate category lists\n");
+        exit(EXIT_FAILURE);
+    }
+    lists->count = service->categoryCount;
+    for (i = 0; i < service->categoryCount; i++) {
+        lists->heads[i] = NIL_INDEX;
+    }
+    atomic_store(&service->categoryLists, lists);
+    epoch_init(&service->categoryEpoch);
+}
+
+void service_destroy_structures(struct streaming_service *service) {
+	/*Free the user table, their suggested movies and watch histories live in the pools*/
+    mem_stats_release_all(&service->memStats, MEM_USERS);
+    user_table_destroy(&service->userTable);
+
+    /*Free new movies list*/
+    while (service->newMoviesList != NULL) {
+        struct new_movie *tempNewMovie = service->newMoviesList;
+        service->newMoviesList = service->newMoviesList->next;
+        free(tempNewMovie);
+        mem_stats_free(&service->memStats, MEM_NEW_MOVIES, sizeof(struct new_movie));
+    }
+
+    /*Category-specific movie lists are released along with the pools, retired versions first*/
+    epoch_destroy(&service->categoryEpoch);
+    free(atomic_exchange(&service->categoryLists, NULL));
+    mem_stats_release_all(&service->memStats, MEM_WATCH_HISTORIES);
+    mem_stats_release_all(&service->memStats, MEM_SUGGESTED_LISTS);
+    mem_stats_release_all(&service->memStats, MEM_CATEGORY_LISTS);
+    node_pool_destroy(&service->moviePool);
+    node_pool_destroy(&service->suggestedPool);
+    movie_catalog_destroy(&service->movieCatalog);
+    watch_stats_destroy(&service->watchStats);
+    cowatch_destroy(&service->coWatch);
+}
+
 /*functions to help the control flow*/
-/*Function to check if a user already exists in the linked list*/
-int user_exists(int uid) {
-    struct user* current = userList;
-    while (current && current->uid != SENTINEL_UID) {
-        if (current->uid == uid) {
-            return 1; /* user already exists */
+/*Function to check if a user already exists in the user table*/
+int user_exists(struct streaming_service *service, int uid) {
+    return user_table_find(&service->userTable, uid) != NIL_INDEX;
+}
+
+/* The function find_user_by_uid looks a user up in the user table based on their UID and returns a pointer to the user if found, or NULL if not found.*/
+struct user* find_user_by_uid(struct streaming_service *service, int uid) {
+    uint32_t handle = user_table_find(&service->userTable, uid);
+    return handle != NIL_INDEX ? USER_RECORD(service, handle) : NULL;
+}
+
+/*category table*/
+static const char *const defaultCategoryNames[DEFAULT_CATEGORY_COUNT] = {
+    "Horror", "Sci-Fi", "Drama", "Romance", "Documentary", "Comedy"
+};
+
+/*The function appends a copy of name to the category table*/
+static int add_category_name(struct streaming_service *service, const char *name, int *capacity) {
+    char *copy;
+    if (service->categoryCount == *capacity) {
+        int newCapacity = *capacity ? *capacity * 2 : 16;
+        char **grown = (char **)realloc(service->categoryNames, (size_t)newCapacity * sizeof(char *));
+        if (grown == NULL) {
+            return -1;
         }
-        current = current->next;
+        service->categoryNames = grown;
+        *capacity = newCapacity;
     }
-    return 0; /* user does not exist */
+    copy = (char *)malloc(strlen(name) + 1);
+    if (copy == NULL) {
+        return -1;
+    }
+    strcpy(copy, name);
+    service->categoryNames[service->categoryCount++] = copy;
+    return 0;
 }
 
-/* The function find_user_by_uid searches for a user in a linked list based on their UID and returns a pointer to the user if found, or NULL if not found.*/
-struct user* find_user_by_uid(int uid) {
-    struct user* current = userList;
+/*The function loads the category table from a file with one name per line, or the built-in one*/
+int service_load_category_names(struct streaming_service *service, const char *path) {
+    char line[MAX_CATEGORY_NAME + 2];
+    int capacity = 0, i;
+    FILE *file;
 
-    while (current && current->uid != SENTINEL_UID) {
-        if (current->uid == uid) {
-            return current; /*User with matching UID found*/
+    service_free_category_names(service);
+    if (path == NULL) {
+        for (i = 0; i < DEFAULT_CATEGORY_COUNT; i++) {
+            if (add_category_name(service, defaultCategoryNames[i], &capacity) != 0) {
+                service_free_category_names(service);
+                return -1;
+            }
         }
-        current = current->next;
+        return 0;
     }
 
-    return NULL; /*User with the specified UID was not found*/
+    file = fopen(path, "r");
+    if (file == NULL) {
+        perror("fopen error for category file");
+        return -1;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        char *name = line, *end;
+        size_t len = strlen(line);
+        if (len == sizeof(line) - 1 && line[len - 1] != '\n' && !feof(file)) {
+            fprintf(stderr, "Category name longer than %d characters in %s\n", MAX_CATEGORY_NAME, path);
+            break;
+        }
+        while (isspace((unsigned char)*name)) {
+            name++;
+        }
+        end = name + strlen(name);
+        while (end > name && isspace((unsigned char)end[-1])) {
+            *--end = '\0';
+        }
+        if (*name == '\0' || *name == '#') {
+            continue;
+        }
+        if (service->categoryCount == MAX_CATEGORY_COUNT) {
+            fprintf(stderr, "More than %d categories in %s\n", MAX_CATEGORY_COUNT, path);
+            break;
+        }
+        if (add_category_name(service, name, &capacity) != 0) {
+            break;
+        }
+    }
+    if (!feof(file) || service->categoryCount == 0) {
+        if (service->categoryCount == 0) {
+            fprintf(stderr, "No category in %s\n", path);
+        }
+        fclose(file);
+        service_free_category_names(service);
+        return -1;
+    }
+    fclose(file);
+    return 0;
+}
+
+/*The function releases the category table*/
+void service_free_category_names(struct streaming_service *service) {
+    int i;
+    for (i = 0; i < service->categoryCount; i++) {
+        free(service->categoryNames[i]);
+    }
+    free(service->categoryNames);
+    service->categoryNames = NULL;
+    service->categoryCount = 0;
 }
 
 /*The function get_category_name takes a movie category as input and returns the corresponding category name as a string*/
-const char* get_category_name(movieCategory_t category) {
-    switch (category) {
-        case HORROR: 
-            return "Horror";
-        case SCIFI: 
-            return "Sci-Fi";
-        case DRAMA: 
-            return "Drama";
-        case ROMANCE: 
-            return "Romance";
-        case DOCUMENTARY: 
-            return "Documentary";
-        case COMEDY: 
-            return "Comedy";
-        default: 
-            return "Unknown"; /*Default case*/
-    }
-}
-
-/*The function creates a linked list of suggested movies based on a given category and year.*/
-struct suggested_movie* create_suggested_movie_list(movieCategory_t category, unsigned year) {
-    struct suggested_movie *head = NULL;
-    struct suggested_movie *tail = NULL;
-    struct movie *currentMovie = categoryLists[category];
-    while(currentMovie != NULL) {
-        if(currentMovie->info.year >= year) {
-            struct suggested_movie *newNode = (struct suggested_movie *)malloc(sizeof(struct suggested_movie));
-            newNode->info = currentMovie->info;
-            newNode->next = NULL;
-            newNode->prev = tail;
-            if (tail) {
-                tail->next = newNode;
-            } else {
-                head = newNode;
-            }
-            tail = newNode;
-        }
-        currentMovie = currentMovie->next;
+const char *service_get_category_name(struct streaming_service *service, int category) {
+    if (category < 0 || category >= service->categoryCount) {
+        return "Unknown"; /*Default case*/
     }
-    return head;
+    return service->categoryNames[category];
 }
 
-/*The function adds a suggested movie to a user's list of suggested movies.*/
-void add_suggested_movie_to_user(struct user *user, struct suggested_movie *suggestion) {
-    struct suggested_movie *newNode = (struct suggested_movie *)malloc(sizeof(struct suggested_movie));
-    newNode->info = suggestion->info;
-    newNode->next = NULL;
-    newNode->prev = user->suggestedTail;
-    if (user->suggestedTail) {
-        user->suggestedTail->next = newNode;
-    } else {
-        user->suggestedHead = newNode;
+/*helpers for the published category lists*/
+/*The function returns the current category lists, only the writer may use it without pinning a snapshot*/
+const struct category_lists *service_current_category_lists(struct streaming_service *service) {
+    return atomic_load_explicit(&service->categoryLists, memory_order_relaxed);
+}
+
+/*The function allocates an unpublished category list node for slot*/
+static uint32_t new_category_node(struct streaming_service *service, uint32_t slot, uint32_t next) {
+    uint32_t idx = node_pool_alloc(&service->moviePool);
+    if (idx != NIL_INDEX) {
+        MOVIE_NODE(service, idx)->slot = slot;
+        MOVIE_NODE(service, idx)->next = next;
+        mem_stats_alloc(&service->memStats, MEM_CATEGORY_LISTS, sizeof(struct movie));
     }
-    user->suggestedTail = newNode;
+    return idx;
+}
+
+/*The function frees the nodes of a chain that was never published, up to stop*/
+static void free_category_chain(struct streaming_service *service, uint32_t head, uint32_t stop) {
+    while (head != stop) {
+        uint32_t next = MOVIE_NODE(service, head)->next;
+        node_pool_free(&service->moviePool, head);
+        mem_stats_free(&service->memStats, MEM_CATEGORY_LISTS, sizeof(struct movie));
+        head = next;
+    }
+}
+
+/*The function retires the published nodes from head up to stop, readers may still be traversing them*/
+static void retire_category_chain(struct streaming_service *service, uint32_t head, uint32_t stop) {
+    while (head != stop) {
+        uint32_t next = MOVIE_NODE(service, head)->next;
+        epoch_retire_node(&service->categoryEpoch, &service->moviePool, head);
+        mem_stats_free(&service->memStats, MEM_CATEGORY_LISTS, sizeof(struct movie));
+        head = next;
+    }
+}
+
+/*The function publishes a new version of the category lists and retires the previous one*/
+static void publish_category_lists(struct streaming_service *service, struct category_lists *lists) {
+    struct category_lists *previous = atomic_exchange_explicit(&service->categoryLists, lists, memory_order_acq_rel);
+    epoch_retire_ptr(&service->categoryEpoch, previous);
+    epoch_advance(&service->categoryEpoch);
 }
 
-/*The function merges two linked lists of suggested movies based on their movie IDs.*/
-struct suggested_movie* merge_suggested_movie_lists(struct suggested_movie *list1, struct suggested_movie *list2) {
-    struct suggested_movie *mergedHead = NULL, *mergedTail = NULL;
+/*The function links node into a user's suggested list right after prev, at the head when prev is NIL_INDEX*/
+static void link_suggested(struct streaming_service *service, struct user *user, uint32_t node, uint32_t prev) {
+    uint32_t next = prev != NIL_INDEX ? SUGGESTED_NODE(service, prev)->next : user->suggestedHead;
+    SUGGESTED_NODE(service, node)->prev = prev;
+    SUGGESTED_NODE(service, node)->next = next;
+    if (prev != NIL_INDEX) {
+        SUGGESTED_NODE(service, prev)->next = node;
+    } else {
+        user->suggestedHead = node;
+    }
+    if (next != NIL_INDEX) {
+        SUGGESTED_NODE(service, next)->prev = node;
+    } else {
+        user->suggestedTail = node;
+    }
+    user->suggestedCount++;
+}
 
-    while (list1 != NULL && list2 != NULL) {
-        struct suggested_movie **nodeToAdd = NULL;
-        if (list1->info.mid < list2->info.mid) {
-            nodeToAdd = &list1;
+/*The function drops the head or the tail of a user's suggested list once it holds more than suggestedCap movies.
+  Returns the dropped node, freed already, or NIL_INDEX*/
+static uint32_t evict_suggested(struct streaming_service *service, struct user *user, int fromTail) {
+    uint32_t victim = fromTail ? user->suggestedTail : user->suggestedHead;
+    if (service->suggestedCap == 0 || user->suggestedCount <= service->suggestedCap) {
+        return NIL_INDEX;
+    }
+    struct suggested_movie *node = SUGGESTED_NODE(service, victim);
+    if (fromTail) {
+        user->suggestedTail = node->prev;
+        if (node->prev != NIL_INDEX) {
+            SUGGESTED_NODE(service, node->prev)->next = NIL_INDEX;
         } else {
-            nodeToAdd = &list2;
+            user->suggestedHead = NIL_INDEX;
         }
-
-        if (mergedTail) {
-            mergedTail->next = *nodeToAdd;
-            (*nodeToAdd)->prev = mergedTail;
-            mergedTail = mergedTail->next;
+    } else {
+        user->suggestedHead = node->next;
+        if (node->next != NIL_INDEX) {
+            SUGGESTED_NODE(service, node->next)->prev = NIL_INDEX;
         } else {
-            mergedHead = *nodeToAdd;
-            mergedTail = mergedHead;
+            user->suggestedTail = NIL_INDEX;
         }
+    }
+    node_pool_free(&service->suggestedPool, victim);
+    mem_stats_free(&service->memStats, MEM_SUGGESTED_LISTS, sizeof(struct suggested_movie));
+    user->suggestedCount--;
+    service->suggestedEvictions++;
+    return victim;
+}
 
-        *nodeToAdd = (*nodeToAdd)->next;
+/*The function appends a list of suggested movies to the end of a user's list of suggested movies,
+  the oldest suggestions at the head making room for them when the list is capped*/
+void add_suggested_movies_to_user(struct streaming_service *service, struct user *user, uint32_t suggestions) {
+    while (suggestions != NIL_INDEX) {
+        uint32_t next = SUGGESTED_NODE(service, suggestions)->next;
+        link_suggested(service, user, suggestions, user->suggestedTail);
+        evict_suggested(service, user, 0);
+        suggestions = next;
     }
+}
 
-    /*Append any remaining elements of list1 or list2*/
-    if (list1) {
-        if (mergedTail) {
-            mergedTail->next = list1;
-            list1->prev = mergedTail;
-        } else {
-            mergedHead = list1;
+/*one category list in the k-way merge, at its next movie recent enough*/
+struct merge_cursor {
+    unsigned mid;
+    unsigned order;     /*position of the category in the request*/
+    uint32_t node;
+};
+
+/*The function tells if cursor a goes first: smaller movie ID, and on equal IDs the category requested last, as F always did*/
+static int cursor_before(const struct merge_cursor *a, const struct merge_cursor *b) {
+    return a->mid < b->mid || (a->mid == b->mid && a->order > b->order);
+}
+
+/*The function moves the cursor at heap[at] down to its place*/
+static void cursor_sift_down(struct merge_cursor *heap, unsigned size, unsigned at) {
+    struct merge_cursor moved = heap[at];
+    for (;;) {
+        unsigned child = 2 * at + 1;
+        if (child >= size) {
+            break;
         }
-    } else if (list2) {
-        if (mergedTail) {
-            mergedTail->next = list2;
-            list2->prev = mergedTail;
-        } else {
-            mergedHead = list2;
+        if (child + 1 < size && cursor_before(&heap[child + 1], &heap[child])) {
+            child++;
+        }
+        if (!cursor_before(&heap[child], &moved)) {
+            break;
         }
+        heap[at] = heap[child];
+        at = child;
     }
+    heap[at] = moved;
+}
+
+/*The function moves node forward to the first movie released in year or later, returns 0 at the end of the list*/
+static int cursor_seek(struct streaming_service *service, struct merge_cursor *cursor, uint32_t node, unsigned year) {
+    while (node != NIL_INDEX && SLOT_INFO(service, MOVIE_NODE(service, node)->slot)->year < year) {
+        node = MOVIE_NODE(service, node)->next;
+    }
+    if (node == NIL_INDEX) {
+        return 0;
+    }
+    cursor->node = node;
+    cursor->mid = SLOT_INFO(service, MOVIE_NODE(service, node)->slot)->mid;
+    return 1;
+}
+
+/*initial room of a merge, in movies*/
+#define MERGE_INITIAL_SLOTS 64
+
+/*The function collects the movies of count categories of lists released in year or later, sorted,
+  with a heap based k-way merge. It allocates no list node, so it may run on any thread that pinned lists*/
+int service_merge_suggestions(struct streaming_service *service, const struct category_lists *lists,
+        const int *categories, unsigned count, unsigned year, struct suggestion_merge *merge) {
+    unsigned size = 0, cap = 0, i;
+    struct merge_cursor *heap = (struct merge_cursor *)malloc((count ? count : 1) * sizeof(struct merge_cursor));
+
+    merge->slots = NULL;
+    merge->count = 0;
+    merge->failed = heap == NULL;
+    if (heap == NULL) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        if (categories[i] >= 0 && categories[i] < lists->count) {
+            heap[size].order = i;
+            size += cursor_seek(service, &heap[size], lists->heads[categories[i]], year);
+        }
+    }
+    for (i = size / 2; i-- > 0;) {
+        cursor_sift_down(heap, size, i);
+    }
+
+    while (size > 0) {
+        if (merge->count == cap) {
+            unsigned newCap = cap ? cap * 2 : MERGE_INITIAL_SLOTS;
+            uint32_t *grown = (uint32_t *)realloc(merge->slots, newCap * sizeof(uint32_t));
+            if (grown == NULL) {
+                merge->failed = 1;
+                break; /*Out of memory, suggest what was collected so far*/
+            }
+            merge->slots = grown;
+            cap = newCap;
+        }
+        merge->slots[merge->count++] = MOVIE_NODE(service, heap[0].node)->slot;
 
-    return mergedHead;
+        if (!cursor_seek(service, &heap[0], MOVIE_NODE(service, heap[0].node)->next, year)) {
+            heap[0] = heap[--size];
+        }
+        if (size > 0) {
+            cursor_sift_down(heap, size, 0);
+        }
+    }
+    free(heap);
+    return merge->failed ? -1 : 0;
+}
+
+/*The function releases the movies of a merge*/
+void service_suggestion_merge_free(struct suggestion_merge *merge) {
+    free(merge->slots);
+    merge->slots = NULL;
+    merge->count = 0;
+}
+
+/*The function appends the movies of a merge to user's suggested movies, returns how many it could allocate*/
+static unsigned splice_suggestions(struct streaming_service *service, struct user *user, const struct suggestion_merge *merge) {
+    unsigned i;
+    for (i = 0; i < merge->count; i++) {
+        uint32_t newIdx = node_pool_alloc(&service->suggestedPool);
+        if (newIdx == NIL_INDEX) {
+            break;
+        }
+        mem_stats_alloc(&service->memStats, MEM_SUGGESTED_LISTS, sizeof(struct suggested_movie));
+        SUGGESTED_NODE(service, newIdx)->slot = merge->slots[i];
+        link_suggested(service, user, newIdx, user->suggestedTail);
+        evict_suggested(service, user, 0);
+    }
+    return i;
+}
+
+/*The function suggests to user the movies of count categories released in year or later, then prints the user's suggestions.
+  merged holds them if they were merged ahead on the current lists, NULL merges them here*/
+static int suggest_from_categories(struct streaming_service *service, struct user *user, const int *categories, unsigned count,
+        unsigned year, const struct suggestion_merge *merged) {
+    struct suggestion_merge own;
+    unsigned added;
+    int failed;
+
+    if (merged == NULL) {
+        service_merge_suggestions(service, service_current_category_lists(service), categories, count, year, &own);
+        merged = &own;
+    }
+    added = splice_suggestions(service, user, merged);
+    failed = merged->failed || added < merged->count;
+    if (merged == &own) {
+        service_suggestion_merge_free(&own);
+    }
+
+    if (added == 0) {
+        if (failed) {
+            fprintf(service->out, "Could not allocate memory\n");
+            return -1;
+        }
+        fprintf(service->out, "No suggestions available.\n");
+    }
+    fprintf(service->out, "User <%d> Suggested Movies = ", user->uid);
+    uint32_t currentSuggestedMovie = user->suggestedHead;
+    while (currentSuggestedMovie != NIL_INDEX) {
+        struct suggested_movie *suggested = SUGGESTED_NODE(service, currentSuggestedMovie);
+        fprintf(service->out, "<%d>", SLOT_INFO(service, suggested->slot)->mid);
+        if (suggested->next != NIL_INDEX) {
+            fprintf(service->out, ", ");
+        }
+        currentSuggestedMovie = suggested->next;
+    }
+    fprintf(service->out, "\nDONE\n");
+    return 0;
 }
 
 /*printing functions*/
-/*print categorized movies list*/
-void print_categorized_movies(){
-    movieCategory_t category;
+/*print categorized movies list of one version of the category lists*/
+void print_categorized_movies(struct streaming_service *service, FILE *out, const struct category_lists *lists){
+    int category;
     int position;
-    for (category = HORROR; category <= COMEDY; category++) {
+    for (category = 0; category < lists->count; category++) {
         /*Get the category name using get_category_name function*/
-        const char* categoryName = get_category_name(category);
-        printf("%s: ", categoryName);
+        const char* categoryName = service_get_category_name(service, category);
+        fprintf(out, "%s: ", categoryName);
 
         /*Traverse the movie list for the current category*/
-        struct movie* current = categoryLists[category];
+        uint32_t current = lists->heads[category];
         position = 1;
-        while (current != NULL) {
+        while (current != NIL_INDEX) {
+            struct movie *movie = MOVIE_NODE(service, current);
             /*Print movie ID and category, followed by a comma if not the last movie*/
-            printf("<%d,%d>", current->info.mid, position);
-            if (current->next != NULL) {
-                printf(", ");
+            fprintf(out, "<%d,%d>", SLOT_INFO(service, movie->slot)->mid, position);
+            if (movie->next != NIL_INDEX) {
+                fprintf(out, ", ");
             }
-            current = current->next; /*Move to the next movie in the category*/
+            current = movie->next; /*Move to the next movie in the category*/
             position ++;
         }
 
-        printf("\n"); /*Print a newline to separate categories*/
+        fprintf(out, "\n"); /*Print a newline to separate categories*/
     }
-    printf("DONE\n");
+    fprintf(out, "DONE\n");
 }
 
 /*print users list*/
-void print_users_list(void){
-    printf("Users = ");
-    struct user *current = userList;
-    while (current-> uid != SENTINEL_UID) {
-        printf("<%d>,", current->uid);
-        current = current->next;
+void print_users_list(struct streaming_service *service){
+    fprintf(service->out, "Users = ");
+    uint32_t current = service->userTable.newest;
+    while (current != NIL_INDEX) {
+        fprintf(service->out, "<%d>,", USER_RECORD(service, current)->uid);
+        current = USER_RECORD(service, current)->older;
     }
 }
 
 /*Starting the fucntions for the events*/
-/*Event R- Function to register a new user and add them to the linked list*/
-int register_user(int uid) {
-    if (user_exists(uid)) {
-        printf("\nThe user with uid %d already exists.\n", uid);
+/*Event R- Function to register a new user as the newest entry of the user table*/
+int service_register_user(struct streaming_service *service, int uid) {
+    if (user_exists(service, uid)) {
+        fprintf(service->out, "\nThe user with uid %d already exists.\n", uid);
         return -1;
     }
 
-    struct user *newUser = malloc(sizeof(*newUser));
-    if (!newUser) {
-        printf("\nMemory allocation failed.\n");
+    if (user_table_add(&service->userTable, uid) == NIL_INDEX) {
+        fprintf(service->out, "\nMemory allocation failed.\n");
         return -1;
     }
+    mem_stats_alloc(&service->memStats, MEM_USERS, sizeof(struct user));
 
-    newUser->uid = uid;
-    newUser->suggestedHead = NULL;
-    newUser->suggestedTail = NULL;
-    newUser->watchHistory = NULL;
-    newUser->next = userList;
-    userList = newUser;
-
-    printf("R <%d>\n", uid);
-    print_users_list();
-    printf("\nDone\n");
+    fprintf(service->out, "R <%d>\n", uid);
+    print_users_list(service);
+    fprintf(service->out, "\nDone\n");
     return 0;
 }
 
-/*Event U- Function to unregister a user and remove them from the linked list*/
-void unregister_user(int uid) {
-    struct user *current = userList;
-    struct user *prev = NULL;
+/*Event U- Function to unregister a user and free their record of the user table*/
+void service_unregister_user(struct streaming_service *service, int uid) {
+    uint32_t handle = user_table_find(&service->userTable, uid);
     /*Search for the user with the given UID*/
-    if (!user_exists(uid)) {
-        printf("\nUser with UID %d not found.\n", uid);
+    if (handle == NIL_INDEX) {
+        fprintf(service->out, "\nUser with UID %d not found.\n", uid);
         return;
     }
-    while (current && current->uid != SENTINEL_UID) {
-        if (current->uid == uid) {
-            /*Remove the user from the linked list*/
-            if (prev != NULL) {
-                prev->next = current->next;
-            } else {
-                userList = current->next;
-            }
-            printf("U %d\n", uid);
+    struct user *current = USER_RECORD(service, handle);
+    fprintf(service->out, "U %d\n", uid);
 
-            while (current->suggestedHead) {
-                struct suggested_movie *tmp = current->suggestedHead;
-                current->suggestedHead = tmp->next;
-                free(tmp);
-            }
-            while (current->watchHistory) {
-                struct movie *tmp = current->watchHistory;
-                current->watchHistory = tmp->next;
-                free(tmp);
-            }
-            free(current);
-            break;
-        }
-        prev = current;
-        current = current->next;
+    while (current->suggestedHead != NIL_INDEX) {
+        uint32_t tmp = current->suggestedHead;
+        current->suggestedHead = SUGGESTED_NODE(service, tmp)->next;
+        node_pool_free(&service->suggestedPool, tmp);
+        mem_stats_free(&service->memStats, MEM_SUGGESTED_LISTS, sizeof(struct suggested_movie));
     }
+    while (current->watchHistory != NIL_INDEX) {
+        uint32_t tmp = current->watchHistory;
+        current->watchHistory = MOVIE_NODE(service, tmp)->next;
+        node_pool_free(&service->moviePool, tmp);
+        mem_stats_free(&service->memStats, MEM_WATCH_HISTORIES, sizeof(struct movie));
+    }
+    user_table_remove(&service->userTable, handle);
+    mem_stats_free(&service->memStats, MEM_USERS, sizeof(struct user));
+
     /*Print the updated list of users*/
-    print_users_list();
-    printf("\nDone\n");
+    print_users_list(service);
+    fprintf(service->out, "\nDone\n");
 }
 
 /*Event A- Function to add a new movie to the sorted list of new releases*/
-int add_new_movie(unsigned mid, movieCategory_t category, unsigned year) {
+int service_add_new_movie(struct streaming_service *service, unsigned mid, movieCategory_t category, unsigned year) {
+    if ((int)category < 0 || (int)category >= service->categoryCount) {
+        fprintf(service->out, "A <%u> <%d> <%u>\n", mid, category, year);
+        fprintf(service->out, "Category %d does not exist\n", category);
+        return -1; /*D would have no list to put it in*/
+    }
     struct new_movie *newMovie = (struct new_movie *)malloc(sizeof(struct new_movie));
     if (newMovie == NULL) {
         return -1; /*Memory allocation failed, return -1*/
     }
+    mem_stats_alloc(&service->memStats, MEM_NEW_MOVIES, sizeof(struct new_movie));
     newMovie->info.mid = mid;
     newMovie->category = category; 
     newMovie->info.year = year;
     newMovie->next = NULL;
 
-    struct new_movie *current = newMoviesList;
+    struct new_movie *current = service->newMoviesList;
     struct new_movie *prev = NULL;
 
     /*Find the correct position to insert the new movie in sorted order*/
@@ -259,321 +561,856 @@ int add_new_movie(unsigned mid, movieCategory_t category, unsigned year) {
 
     if (prev == NULL) {
         /*Insert at the beginning of the list*/
-        newMovie->next = newMoviesList;
-        newMoviesList = newMovie;
+        newMovie->next = service->newMoviesList;
+        service->newMoviesList = newMovie;
     } else {
         /*Insert in the middle or at the end of the list*/
         prev->next = newMovie;
         newMovie->next = current;
     }
 
-    printf("A <%u> <%d> <%u>\n", mid, category, year); /*Print the added new movie*/
-    printf("New movies = "); /*print the list with updated list with the movies*/
-    struct new_movie *temp = newMoviesList;
+    fprintf(service->out, "A <%u> <%d> <%u>\n", mid, category, year); /*Print the added new movie*/
+    fprintf(service->out, "New movies = "); /*print the list with updated list with the movies*/
+    struct new_movie *temp = service->newMoviesList;
     while (temp != NULL) {
-        printf(" <%u,%d,%u>", temp->info.mid, temp->category, temp->info.year);
+        fprintf(service->out, " <%u,%d,%u>", temp->info.mid, temp->category, temp->info.year);
         temp = temp->next;
     }
-    printf("\nDONE\n");
+    fprintf(service->out, "\nDONE\n");
     return 0;
 }
 
 /*Event D- The function distribute_new_movies categorizes new movies and inserts them into the appropriate category list.*/
-void distribute_new_movies(void) {
-    struct new_movie *current = newMoviesList;
+void service_distribute_new_movies(struct streaming_service *service) {
+    const struct category_lists *lists = service_current_category_lists(service);
+    struct new_movie *current;
+    size_t count = 0, i, start;
+    int category;
 
-    while (current != NULL) {
-        int category = current->category;
-        struct movie *newMovie = (struct movie *)malloc(sizeof(struct movie));
-        newMovie->info = current->info;
-        newMovie->next = NULL;
+    /* The lists are rebuilt aside and published at once, readers keep the previous version meanwhile */
+    for (current = service->newMoviesList; current != NULL; current = current->next) {
+        count++;
+    }
+    struct category_lists *next = (struct category_lists *)malloc(CATEGORY_LISTS_SIZE(service->categoryCount));
+    struct new_movie **sorted = (struct new_movie **)malloc((count ? count : 1) * sizeof(struct new_movie *));
+    uint32_t *slots = (uint32_t *)malloc((count ? count : 1) * sizeof(uint32_t));
+    size_t *firstOf = (size_t *)calloc(2 * (size_t)service->categoryCount + 1, sizeof(size_t));
+    if (next == NULL || sorted == NULL || slots == NULL || firstOf == NULL) {
+        free(next);
+        free(sorted);
+        free(slots);
+        free(firstOf);
+        fprintf(service->out, "Could not allocate memory\n");
+        return;
+    }
+    size_t *fill = firstOf + service->categoryCount + 1;
+    memcpy(next, lists, CATEGORY_LISTS_SIZE(service->categoryCount));
 
-        struct movie *currentCategory = categoryLists[category];
-        struct movie *prevCategory = NULL;
+    /* Group the new movies by category, keeping their increasing movie ID order, A only takes listed categories */
+    for (current = service->newMoviesList; current != NULL; current = current->next) {
+        firstOf[current->category + 1]++;
+    }
+    for (category = 0; category < service->categoryCount; category++) {
+        firstOf[category + 1] += firstOf[category];
+    }
+    memcpy(fill, firstOf, service->categoryCount * sizeof(size_t));
+    for (current = service->newMoviesList; current != NULL; current = current->next) {
+        size_t at = fill[current->category]++;
+        sorted[at] = current;
+        slots[at] = movie_catalog_intern(&service->movieCatalog, current->info.mid, current->info.year);
+        watch_stats_set_category(&service->watchStats, current->info.mid, current->category, slots[at]);
+    }
 
-        /* Find the correct position to insert the new movie in the category list */
-        while (currentCategory != NULL && currentCategory->info.mid < current->info.mid) {
-            prevCategory = currentCategory;
-            currentCategory = currentCategory->next;
+    for (category = 0; category < service->categoryCount; category++) {
+        uint32_t oldCurrent = lists->heads[category];
+        uint32_t newHead = NIL_INDEX, newTail = NIL_INDEX;
+        int failed = 0;
+
+        if (firstOf[category] == firstOf[category + 1]) {
+            continue;
+        }
+        /* A movie goes before the movies with the same ID already listed, later ones in front */
+        for (start = firstOf[category]; start < firstOf[category + 1]; start = i) {
+            size_t low, high;
+            for (i = start; i < firstOf[category + 1] && sorted[i]->info.mid == sorted[start]->info.mid; i++);
+            for (low = start, high = i - 1; low < high; low++, high--) {
+                struct new_movie *tmpMovie = sorted[low];
+                uint32_t tmpSlot = slots[low];
+                sorted[low] = sorted[high];
+                slots[low] = slots[high];
+                sorted[high] = tmpMovie;
+                slots[high] = tmpSlot;
+            }
         }
 
-        if (prevCategory == NULL) {
-            /* Insert at the beginning of the category list */
-            newMovie->next = categoryLists[category];
-            categoryLists[category] = newMovie;
-        } else {
-            /* Insert in the middle or at the end of the category list */
-            prevCategory->next = newMovie;
-            newMovie->next = currentCategory;
+        /* Merge, copying the old nodes in front of the last new movie and sharing the rest */
+        for (i = firstOf[category]; i < firstOf[category + 1] && !failed; i++) {
+            while (!failed && oldCurrent != NIL_INDEX && SLOT_INFO(service, MOVIE_NODE(service, oldCurrent)->slot)->mid < sorted[i]->info.mid) {
+                uint32_t copy = new_category_node(service, MOVIE_NODE(service, oldCurrent)->slot, NIL_INDEX);
+                failed = copy == NIL_INDEX;
+                if (!failed) {
+                    if (newTail != NIL_INDEX) {
+                        MOVIE_NODE(service, newTail)->next = copy;
+                    } else {
+                        newHead = copy;
+                    }
+                    newTail = copy;
+                    oldCurrent = MOVIE_NODE(service, oldCurrent)->next;
+                }
+            }
+            if (!failed && slots[i] != NIL_INDEX) {
+                uint32_t newIdx = new_category_node(service, slots[i], NIL_INDEX);
+                failed = newIdx == NIL_INDEX;
+                if (!failed) {
+                    if (newTail != NIL_INDEX) {
+                        MOVIE_NODE(service, newTail)->next = newIdx;
+                    } else {
+                        newHead = newIdx;
+                    }
+                    newTail = newIdx;
+                }
+            }
+        }
+        if (failed) {
+            /* Out of memory, this category keeps its current list */
+            free_category_chain(service, newHead, NIL_INDEX);
+            continue;
+        }
+        if (newTail != NIL_INDEX) {
+            MOVIE_NODE(service, newTail)->next = oldCurrent;
+            retire_category_chain(service, lists->heads[category], oldCurrent);
+            next->heads[category] = newHead;
         }
+    }
+    publish_category_lists(service, next);
+    free(sorted);
+    free(slots);
+    free(firstOf);
 
-        /* Move to the next new movie */
-        struct new_movie *temp = current;
-        current = current->next;
+    /* The new movies list is empty after distribution */
+    while (service->newMoviesList != NULL) {
+        struct new_movie *temp = service->newMoviesList;
+        service->newMoviesList = service->newMoviesList->next;
         free(temp);
+        mem_stats_free(&service->memStats, MEM_NEW_MOVIES, sizeof(struct new_movie));
     }
-    newMoviesList = NULL;
-    printf("D\nCategorized Movies:\n");
-    print_categorized_movies();
+    fprintf(service->out, "D\nCategorized Movies:\n");
+    print_categorized_movies(service, service->out, service_current_category_lists(service));
 }
 
 /*Event W- Function for the user to wantch a movie*/
-int watch_movie(int uid, unsigned mid) {
-    struct user* user = find_user_by_uid(uid); /* Find the user with the specified uid */
+int service_watch_movie(struct streaming_service *service, int uid, unsigned mid) {
+    struct user* user = find_user_by_uid(service, uid); /* Find the user with the specified uid */
 
     if (user == NULL) {
-        printf("User %d does not exist\n", uid);
+        fprintf(service->out, "User %d does not exist\n", uid);
         return -1; /* User with the specified UID does not exist */
     }
 
     /* Create a new movie structure and initialize it */
-    struct movie* new_movie = (struct movie*)malloc(sizeof(struct movie));
-    if (new_movie == NULL) {
+    uint32_t slot = movie_catalog_intern(&service->movieCatalog, mid, 0);
+    uint32_t new_idx = node_pool_alloc(&service->moviePool);
+    if (slot == NIL_INDEX || new_idx == NIL_INDEX) {
+        node_pool_free(&service->moviePool, new_idx);
         return -1; /* Memory allocation failed */
     }
-    new_movie->info.mid = mid;
-    new_movie->info.year = 0;
-    new_movie->next = NULL;
+    mem_stats_alloc(&service->memStats, MEM_WATCH_HISTORIES, sizeof(struct movie));
+    struct movie* new_movie = MOVIE_NODE(service, new_idx);
+    new_movie->slot = slot;
 
     /* Add the new movie to the top of the user's watch history stack */
     new_movie->next = user->watchHistory;
-    user->watchHistory = new_movie;
+    user->watchHistory = new_idx;
+    watch_stats_record(&service->watchStats, mid);
+
+    /* Pair the movie with the previously watched titles of the recent window */
+    uint32_t recent = new_movie->next;
+    int window;
+    for (window = 0; window < COWATCH_WINDOW && recent != NIL_INDEX; window++) {
+        cowatch_add_pair(&service->coWatch, mid, SLOT_INFO(service, MOVIE_NODE(service, recent)->slot)->mid);
+        recent = MOVIE_NODE(service, recent)->next;
+    }
 
     /* Print the watch history */
-    printf("W <%d>, <%d>\n", uid, mid);
-    printf("User %d Watch History = ", uid);
-    struct movie* current_movie = user->watchHistory;
-    while (current_movie != NULL) {
-        printf("%d", current_movie->info.mid);
-        current_movie = current_movie->next;
-        if (current_movie != NULL) {
-            printf(", ");
+    fprintf(service->out, "W <%d>, <%d>\n", uid, mid);
+    fprintf(service->out, "User %d Watch History = ", uid);
+    uint32_t current_movie = user->watchHistory;
+    while (current_movie != NIL_INDEX) {
+        fprintf(service->out, "%d", SLOT_INFO(service, MOVIE_NODE(service, current_movie)->slot)->mid);
+        current_movie = MOVIE_NODE(service, current_movie)->next;
+        if (current_movie != NIL_INDEX) {
+            fprintf(service->out, ", ");
         }
     }
-    printf("\nDONE\n");
+    fprintf(service->out, "\nDONE\n");
     return 0; /* Successfully added the movie to the watch history and printed the history */
 }
 
 /* Event S- Function to suggest movies to user */
-int suggest_movies(int uid){
+int service_suggest_movies(struct streaming_service *service, int uid){
     int counter = 1;
-    struct user *current = userList;
-    struct movie_info i;       
-    while(current->uid != SENTINEL_UID){
-        if(current->uid == uid){
-            break;
-        }
-        current = current->next;
-    }
+    struct user *current = find_user_by_uid(service, uid);
 
-    if(current->uid != uid){
-        printf("User not found.\n");
+    if(current == NULL){
+        fprintf(service->out, "User not found.\n");
         return -1;
     }
 
-    struct suggested_movie *currFront = current->suggestedHead;
-    struct suggested_movie *currBack = current->suggestedTail;
-    struct user *temp = userList;
+    /*Odd suggestions go in after the head side ones, even ones in before the tail side ones*/
+    uint32_t currFront = current->suggestedHead;
+    uint32_t currBack = current->suggestedTail;
+    uint32_t handle;
 
-    while(temp->uid != SENTINEL_UID){
+    for(handle = service->userTable.newest; handle != NIL_INDEX; handle = USER_RECORD(service, handle)->older){
+        struct user *temp = USER_RECORD(service, handle);
         if(temp->uid != uid){
-            if(temp->watchHistory != NULL){
-                struct movie *topMovie = temp->watchHistory;
-                i = topMovie->info;
-                struct suggested_movie *suggestedMovieNode = (struct suggested_movie *)malloc(sizeof(struct suggested_movie));
-                if(suggestedMovieNode == NULL){
-                    printf("Could not allocate memory");
+            if(temp->watchHistory != NIL_INDEX){
+                uint32_t topSlot = MOVIE_NODE(service, temp->watchHistory)->slot;
+                uint32_t suggestedIdx = node_pool_alloc(&service->suggestedPool);
+                uint32_t evicted;
+                if(suggestedIdx == NIL_INDEX){
+                    fprintf(service->out, "Could not allocate memory");
                     return -1;
                 }
-                suggestedMovieNode->info = i;
+                mem_stats_alloc(&service->memStats, MEM_SUGGESTED_LISTS, sizeof(struct suggested_movie));
+                SUGGESTED_NODE(service, suggestedIdx)->slot = topSlot;
                 if(counter % 2 != 0){ /*Pseudocode from the tutorial*/
-                    if(currFront != NULL){
-                        currFront->next = suggestedMovieNode;
+                    link_suggested(service, current, suggestedIdx, currFront);
+                    currFront = suggestedIdx;
+                    /*a capped list gives up its tail for a head side suggestion*/
+                    evicted = evict_suggested(service, current, 1);
+                    if(evicted != NIL_INDEX && evicted == currBack){
+                        currBack = NIL_INDEX;
                     }
-                    suggestedMovieNode->next = NULL;
-                    suggestedMovieNode->prev = currFront;
-                    currFront = suggestedMovieNode;
-                    if(current->suggestedHead == NULL){
-                        current->suggestedHead = currFront;
+                    if(evicted != NIL_INDEX && evicted == currFront){
+                        currFront = current->suggestedTail;
                     }
                 } else {
-                    suggestedMovieNode->prev = NULL;
-                    suggestedMovieNode->next = currBack;
-                    if(currBack != NULL){
-                        currBack->prev = suggestedMovieNode;
+                    link_suggested(service, current, suggestedIdx,
+                            currBack != NIL_INDEX ? SUGGESTED_NODE(service, currBack)->prev : current->suggestedTail);
+                    currBack = suggestedIdx;
+                    /*and its head for a tail side one*/
+                    evicted = evict_suggested(service, current, 0);
+                    if(evicted != NIL_INDEX && evicted == currFront){
+                        currFront = NIL_INDEX;
                     }
-                    currBack = suggestedMovieNode;
-                    if(current->suggestedTail == NULL){
-                        current->suggestedTail = currBack;
+                    if(evicted != NIL_INDEX && evicted == currBack){
+                        currBack = current->suggestedHead;
                     }
                 }
                 counter++;
             }
         }
-        temp = temp->next;
-    }
-    if(currFront != NULL){
-        if(currBack != NULL){
-            currFront->next = currBack;
-            currBack->prev = currFront;
-        } else {
-            currBack = currFront;
-        }
     }
     
-    struct suggested_movie *suggestedMovieIterator = current->suggestedHead;
-    printf("\nS <%d>\n", uid);
-    printf("User <%d> Suggested Movies = ", uid);
-    while(suggestedMovieIterator != NULL){
-        printf("<%d>", suggestedMovieIterator->info.mid);
-        if(suggestedMovieIterator->next != NULL){
-            printf(", ");
+    uint32_t suggestedMovieIterator = current->suggestedHead;
+    fprintf(service->out, "\nS <%d>\n", uid);
+    fprintf(service->out, "User <%d> Suggested Movies = ", uid);
+    while(suggestedMovieIterator != NIL_INDEX){
+        struct suggested_movie *suggested = SUGGESTED_NODE(service, suggestedMovieIterator);
+        fprintf(service->out, "<%d>", SLOT_INFO(service, suggested->slot)->mid);
+        if(suggested->next != NIL_INDEX){
+            fprintf(service->out, ", ");
         }
-        suggestedMovieIterator = suggestedMovieIterator->next;
+        suggestedMovieIterator = suggested->next;
     }
-    printf("\nDONE\n");
+    fprintf(service->out, "\nDONE\n");
     return 0;
 }
 
 /*Event F- filterd movie search*/
-int filtered_movie_search(int uid, movieCategory_t category1, movieCategory_t category2, unsigned year) {
-    printf("F %d %d %d %u\n", uid, category1, category2, year);
-    struct user* user = find_user_by_uid(uid); /* Find the user with the specified uid */
+int service_filtered_movie_search(struct streaming_service *service, int uid, movieCategory_t category1, movieCategory_t category2, unsigned year) {
+    return service_filtered_movie_search_merged(service, uid, category1, category2, year, NULL);
+}
+
+/*Event F with its merge done ahead, or done here if merged is NULL*/
+int service_filtered_movie_search_merged(struct streaming_service *service, int uid, movieCategory_t category1, movieCategory_t category2,
+        unsigned year, const struct suggestion_merge *merged) {
+    fprintf(service->out, "F %d %d %d %u\n", uid, category1, category2, year);
+    struct user* user = find_user_by_uid(service, uid); /* Find the user with the specified uid */
     if (user == NULL) {
-        printf("User %d does not exist\n", uid);
+        fprintf(service->out, "User %d does not exist\n", uid);
+        return -1; /* User with the specified UID does not exist */
+    }
+    int categories[2] = { category1, category2 };
+    return suggest_from_categories(service, user, categories, 2, year, merged);
+}
+
+/*Event G- filtered movie search over any number of categories*/
+int service_multi_category_search(struct streaming_service *service, int uid, const int *categories, unsigned count, unsigned year) {
+    return service_multi_category_search_merged(service, uid, categories, count, year, NULL);
+}
+
+/*Event G with its merge done ahead, or done here if merged is NULL*/
+int service_multi_category_search_merged(struct streaming_service *service, int uid, const int *categories, unsigned count,
+        unsigned year, const struct suggestion_merge *merged) {
+    unsigned i;
+    fprintf(service->out, "G %d %u", uid, year);
+    for (i = 0; i < count; i++) {
+        fprintf(service->out, " %d", categories[i]);
+    }
+    fprintf(service->out, "\n");
+    struct user* user = find_user_by_uid(service, uid); /* Find the user with the specified uid */
+    if (user == NULL) {
+        fprintf(service->out, "User %d does not exist\n", uid);
+        return -1; /* User with the specified UID does not exist */
+    }
+    return suggest_from_categories(service, user, categories, count, year, merged);
+}
+
+/*Event C- Function to suggest the movies most co-watched with the user's recent titles*/
+int service_cowatch_suggest_movies(struct streaming_service *service, int uid, unsigned n) {
+    unsigned titles[COWATCH_WINDOW];
+    unsigned count = 0, t;
+    int found, i;
+
+    fprintf(service->out, "C %d %u\n", uid, n);
+    struct user* user = find_user_by_uid(service, uid); /* Find the user with the specified uid */
+    if (user == NULL) {
+        fprintf(service->out, "User %d does not exist\n", uid);
         return -1; /* User with the specified UID does not exist */
     }
-    
-    struct suggested_movie *first_category_suggestions = create_suggested_movie_list(category1, year);
-    struct suggested_movie *second_category_suggestions = create_suggested_movie_list(category2, year);
 
-    if (first_category_suggestions == NULL && second_category_suggestions == NULL) {
-        printf("No suggestions available.\n");
-    } else if (first_category_suggestions == NULL) {
-        while(second_category_suggestions != NULL) {
-            add_suggested_movie_to_user(user, second_category_suggestions);
-            second_category_suggestions = second_category_suggestions->next;
+    /* Distinct titles among the most recent watches */
+    uint32_t recent = user->watchHistory;
+    for (i = 0; i < COWATCH_WINDOW && recent != NIL_INDEX; i++) {
+        unsigned mid = SLOT_INFO(service, MOVIE_NODE(service, recent)->slot)->mid;
+        int duplicate = 0;
+        for (t = 0; t < count && !duplicate; t++) {
+            duplicate = titles[t] == mid;
         }
-    } else if (second_category_suggestions == NULL) {
-        while(first_category_suggestions != NULL) {
-            add_suggested_movie_to_user(user, first_category_suggestions);
-            first_category_suggestions = first_category_suggestions->next;
+        if (!duplicate) {
+            titles[count++] = mid;
         }
-    } else {
-        struct suggested_movie *merged_suggestions = merge_suggested_movie_lists(first_category_suggestions, second_category_suggestions);
-        while(merged_suggestions != NULL) {
-            add_suggested_movie_to_user(user, merged_suggestions);
-            merged_suggestions = merged_suggestions->next;
+        recent = MOVIE_NODE(service, recent)->next;
+    }
+
+    /* One suggestion per co-watched movie at most */
+    if (n > service->coWatch.rowUsed) {
+        n = service->coWatch.rowUsed;
+    }
+    struct cowatch_score *top = (struct cowatch_score *)malloc((n ? n : 1) * sizeof(struct cowatch_score));
+    if (top == NULL) {
+        return -1;
+    }
+    found = cowatch_top(&service->coWatch, titles, count, n, top);
+    if (found < 0) {
+        free(top);
+        return -1;
+    }
+
+    int suggested = 0;
+    for (i = 0; i < found; i++) {
+        /* The node refers to the catalog entry of the listed movie, so it carries its year and T finds it */
+        uint32_t slot = watch_stats_slot(&service->watchStats, top[i].mid);
+        if (slot == NIL_INDEX) {
+            continue; /* never distributed or taken off */
         }
+        uint32_t newIdx = node_pool_alloc(&service->suggestedPool);
+        if (newIdx == NIL_INDEX) {
+            break;
+        }
+        mem_stats_alloc(&service->memStats, MEM_SUGGESTED_LISTS, sizeof(struct suggested_movie));
+        SUGGESTED_NODE(service, newIdx)->slot = slot;
+        SUGGESTED_NODE(service, newIdx)->next = NIL_INDEX;
+        add_suggested_movies_to_user(service, user, newIdx);
+        suggested++;
+    }
+    free(top);
+
+    if (suggested == 0) {
+        fprintf(service->out, "No suggestions available.\n");
     }
-    printf("User <%d> Suggested Movies = ", user->uid);
-    struct suggested_movie *currentSuggestedMovie = user->suggestedHead;
-    while (currentSuggestedMovie != NULL) {
-        printf("<%d>", currentSuggestedMovie->info.mid);
-        if (currentSuggestedMovie->next != NULL) {
-            printf(", ");
+
+    fprintf(service->out, "User <%d> Suggested Movies = ", user->uid);
+    uint32_t currentSuggestedMovie = user->suggestedHead;
+    while (currentSuggestedMovie != NIL_INDEX) {
+        struct suggested_movie *suggested = SUGGESTED_NODE(service, currentSuggestedMovie);
+        fprintf(service->out, "<%d>", SLOT_INFO(service, suggested->slot)->mid);
+        if (suggested->next != NIL_INDEX) {
+            fprintf(service->out, ", ");
         }
-        currentSuggestedMovie = currentSuggestedMovie->next;
+        currentSuggestedMovie = suggested->next;
     }
-    printf("\nDONE\n");
-return 0;
+    fprintf(service->out, "\nDONE\n");
+    return 0;
 }
 
-/*Event T- takeoff a movie from the service*/
-void take_off_movie(unsigned mid) {
-    int i; /*initialize the variable here because of the ansi standard*/
-    int position;
-    printf("T %u\n", mid);
+/*helpers for batched take-off*/
+/*no T event of the batch removes this occurrence*/
+#define NO_REMOVAL UINT32_MAX
 
-    /* Step 1: Remove the movie from every user's suggested list */
-    struct user* current_user = userList;
-    while (current_user != NULL) {
-        struct suggested_movie* suggested = current_user->suggestedHead;
-        struct suggested_movie* prev_suggested = NULL;
+/*a movie taken off by the batch, with the batch positions of its T events*/
+struct doomed_movie {
+    unsigned mid;
+    uint32_t count;     /*T events of mid in the batch, 0 marks an empty entry*/
+    uint32_t first;     /*index of its first position in the positions array*/
+    uint32_t seen;      /*occurrences met so far in the list being scanned*/
+    uint32_t stamp;     /*list for which seen is valid*/
+};
 
-        while (suggested != NULL) {
-            if (suggested->info.mid == mid) {
-                printf("%u removed from %u suggested list.\n", mid, current_user->uid);
+struct doomed_set {
+    struct doomed_movie *entries;
+    uint32_t mask;
+    uint32_t *positions;   /*batch positions grouped by movie, increasing*/
+    uint32_t stamp;
+};
 
-                if (prev_suggested != NULL) {
-                    prev_suggested->next = suggested->next;
-                } else {
-                    current_user->suggestedHead = suggested->next;
-                }
-                break;
+/*a removal line of the batch output, for a user or a category*/
+struct takeoff_record {
+    uint32_t position;  /*T event of the batch that removes it*/
+    int owner;          /*uid or category*/
+};
+
+struct takeoff_records {
+    struct takeoff_record *items;
+    struct takeoff_record *spare;   /*as large as items, for sorting without allocating*/
+    size_t count, cap;
+};
+
+static uint32_t doomed_hash(const void *entry, const void *context) {
+    (void)context;
+    return hash_u32(((const struct doomed_movie *)entry)->mid);
+}
+
+static int doomed_matches(const void *entry, const void *mid, const void *context) {
+    (void)context;
+    return ((const struct doomed_movie *)entry)->mid == *(const unsigned *)mid;
+}
+
+static int doomed_empty(const void *entry) {
+    return ((const struct doomed_movie *)entry)->count == 0;
+}
+
+/*the set is sized up front to stay under half full*/
+static const struct open_hash_type doomedType = {
+    sizeof(struct doomed_movie), 2, doomed_hash, doomed_matches, doomed_empty
+};
+
+/*The function returns the entry of mid, or the empty entry where it belongs*/
+static struct doomed_movie *doomed_slot(const struct doomed_set *set, unsigned mid) {
+    return &set->entries[open_hash_probe(&doomedType, NULL, set->entries, set->mask, hash_u32(mid), &mid)];
+}
+
+/*The function builds the hash set of the count movies taken off, a movie may appear more than once*/
+static int doomed_set_init(struct doomed_set *set, const unsigned *mids, uint32_t count) {
+    uint32_t capacity = 8, i, offset = 0;
+    while (capacity < 2 * count) {
+        capacity *= 2;
+    }
+    set->entries = (struct doomed_movie *)calloc(capacity, sizeof(struct doomed_movie));
+    set->positions = (uint32_t *)malloc(count * sizeof(uint32_t));
+    set->mask = capacity - 1;
+    set->stamp = 0;
+    if (set->entries == NULL || set->positions == NULL) {
+        free(set->entries);
+        free(set->positions);
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        struct doomed_movie *entry = doomed_slot(set, mids[i]);
+        entry->mid = mids[i];
+        entry->count++;
+    }
+    for (i = 0; i < capacity; i++) {
+        set->entries[i].first = offset;
+        offset += set->entries[i].count;
+    }
+    for (i = 0; i < count; i++) {
+        struct doomed_movie *entry = doomed_slot(set, mids[i]);
+        set->positions[entry->first + entry->seen++] = i;
+    }
+    for (i = 0; i < capacity; i++) {
+        set->entries[i].seen = 0;
+    }
+    return 0;
+}
+
+static void doomed_set_destroy(struct doomed_set *set) {
+    free(set->entries);
+    free(set->positions);
+}
+
+/*The function starts the scan of another list*/
+static void doomed_set_rewind(struct doomed_set *set) {
+    set->stamp++;
+}
+
+/*The function returns the batch position of the T event removing this occurrence of mid in the list being scanned:
+  every T removes the first occurrence left, so the n-th occurrence goes with the n-th T of mid*/
+static uint32_t doomed_removal(struct doomed_set *set, unsigned mid) {
+    struct doomed_movie *entry = doomed_slot(set, mid);
+    if (entry->count == 0) {
+        return NO_REMOVAL;
+    }
+    if (entry->stamp != set->stamp) {
+        entry->stamp = set->stamp;
+        entry->seen = 0;
+    }
+    if (entry->seen == entry->count) {
+        return NO_REMOVAL;
+    }
+    return set->positions[entry->first + entry->seen++];
+}
+
+static int add_takeoff_record(struct takeoff_records *records, uint32_t position, int owner) {
+    if (records->count == records->cap) {
+        size_t newCap = records->cap ? records->cap * 2 : 64;
+        struct takeoff_record *grown = (struct takeoff_record *)realloc(records->items, newCap * sizeof(*grown));
+        if (grown == NULL) {
+            return -1;
+        }
+        records->items = grown;
+        grown = (struct takeoff_record *)realloc(records->spare, newCap * sizeof(*grown));
+        if (grown == NULL) {
+            return -1;
+        }
+        records->spare = grown;
+        records->cap = newCap;
+    }
+    records->items[records->count].position = position;
+    records->items[records->count].owner = owner;
+    records->count++;
+    return 0;
+}
+
+/*The function sorts the records by batch position, keeping the scan order among equal positions.
+  Records of position j end up at [starts[j], starts[j + 1])*/
+static void group_takeoff_records(struct takeoff_records *records, uint32_t count, size_t *starts) {
+    struct takeoff_record *sorted = records->spare;
+    size_t i;
+    uint32_t j;
+
+    memset(starts, 0, ((size_t)count + 1) * sizeof(size_t));
+    for (i = 0; i < records->count; i++) {
+        starts[records->items[i].position + 1]++;
+    }
+    for (j = 0; j < count; j++) {
+        starts[j + 1] += starts[j];
+    }
+    for (i = 0; i < records->count; i++) {
+        sorted[starts[records->items[i].position]++] = records->items[i];
+    }
+    for (j = count; j > 0; j--) {
+        starts[j] = starts[j - 1];
+    }
+    starts[0] = 0;
+    records->spare = records->items;
+    records->items = sorted;
+}
+
+/*The function builds, unpublished, category list head without the movies the batch removes from it.
+  The nodes in front of the last removed one are copied, the rest is shared. Returns -1 on failure*/
+static int remove_from_category(struct streaming_service *service, struct doomed_set *set, uint32_t head, int category,
+        struct takeoff_records *records, uint32_t *newHead) {
+    size_t recordsBefore = records->count;
+    uint32_t current, lastRemoved = NIL_INDEX, copyHead = NIL_INDEX, copyTail = NIL_INDEX;
+
+    doomed_set_rewind(set);
+    for (current = head; current != NIL_INDEX; current = MOVIE_NODE(service, current)->next) {
+        uint32_t position = doomed_removal(set, SLOT_INFO(service, MOVIE_NODE(service, current)->slot)->mid);
+        if (position != NO_REMOVAL) {
+            if (add_takeoff_record(records, position, category) != 0) {
+                records->count = recordsBefore;
+                return -1;
             }
+            lastRemoved = current;
+        }
+    }
+    if (lastRemoved == NIL_INDEX) {
+        *newHead = head;
+        return 0;
+    }
 
-            prev_suggested = suggested;
-            suggested = suggested->next;
+    doomed_set_rewind(set);
+    for (current = head; current != MOVIE_NODE(service, lastRemoved)->next; current = MOVIE_NODE(service, current)->next) {
+        uint32_t copy;
+        if (doomed_removal(set, SLOT_INFO(service, MOVIE_NODE(service, current)->slot)->mid) != NO_REMOVAL) {
+            continue;
+        }
+        copy = new_category_node(service, MOVIE_NODE(service, current)->slot, NIL_INDEX);
+        if (copy == NIL_INDEX) {
+            /* Out of memory, the movies stay in this category */
+            free_category_chain(service, copyHead, NIL_INDEX);
+            records->count = recordsBefore;
+            return -1;
         }
+        if (copyTail != NIL_INDEX) {
+            MOVIE_NODE(service, copyTail)->next = copy;
+        } else {
+            copyHead = copy;
+        }
+        copyTail = copy;
+    }
+    if (copyTail != NIL_INDEX) {
+        MOVIE_NODE(service, copyTail)->next = MOVIE_NODE(service, lastRemoved)->next;
+        *newHead = copyHead;
+    } else {
+        *newHead = MOVIE_NODE(service, lastRemoved)->next;
+    }
+    retire_category_chain(service, head, MOVIE_NODE(service, lastRemoved)->next);
+    return 1;
+}
+
+/*Event T- takeoff a movie from the service*/
+void service_take_off_movie(struct streaming_service *service, unsigned mid) {
+    service_take_off_movies(service, &mid, 1);
+}
 
-        current_user = current_user->next;
+/*Event T on a batch- takeoff count movies in one sweep over the users and the category lists*/
+void service_take_off_movies(struct streaming_service *service, const unsigned *mids, unsigned count) {
+    const struct category_lists *lists = service_current_category_lists(service);
+    struct category_lists *next = NULL;
+    struct takeoff_records userRecords = { NULL, NULL, 0, 0 }, categoryRecords = { NULL, NULL, 0, 0 };
+    struct doomed_set doomed;
+    size_t *userStarts = NULL, *categoryStarts = NULL, r;
+    uint32_t handle, j;
+    int i, changed = 0;
+
+    if (count == 0) {
+        return;
+    }
+    if (doomed_set_init(&doomed, mids, count) != 0) {
+        fprintf(service->out, "Could not allocate memory\n");
+        return;
+    }
+    next = (struct category_lists *)malloc(CATEGORY_LISTS_SIZE(service->categoryCount));
+    userStarts = (size_t *)malloc(((size_t)count + 1) * sizeof(size_t));
+    categoryStarts = (size_t *)malloc(((size_t)count + 1) * sizeof(size_t));
+    if (next == NULL || userStarts == NULL || categoryStarts == NULL) {
+        fprintf(service->out, "Could not allocate memory\n");
+        goto done;
     }
 
-    /* Step 2: Remove the movie from the corresponding category list */
-    for (i = 0; i < CATEGORY_COUNT; i++) {
-        struct movie* current_movie = categoryLists[i];
-        struct movie* prev_movie = NULL;
+    /* Step 1: Remove the movies from every user's suggested list, in one pass per list */
+    for (handle = service->userTable.newest; handle != NIL_INDEX; handle = USER_RECORD(service, handle)->older) {
+        struct user *current_user = USER_RECORD(service, handle);
+        uint32_t suggested = current_user->suggestedHead;
+        uint32_t prev_suggested = NIL_INDEX;
 
-        while (current_movie != NULL) {
-            if (current_movie->info.mid == mid) {
-                if (prev_movie != NULL) {
-                    prev_movie->next = current_movie->next;
+        doomed_set_rewind(&doomed);
+        while (suggested != NIL_INDEX) {
+            struct suggested_movie *node = SUGGESTED_NODE(service, suggested);
+            uint32_t following = node->next;
+            uint32_t position = doomed_removal(&doomed, SLOT_INFO(service, node->slot)->mid);
+
+            if (position != NO_REMOVAL && add_takeoff_record(&userRecords, position, current_user->uid) == 0) {
+                if (prev_suggested != NIL_INDEX) {
+                    SUGGESTED_NODE(service, prev_suggested)->next = following;
                 } else {
-                    categoryLists[i] = current_movie->next;
+                    current_user->suggestedHead = following;
+                }
+                if (following != NIL_INDEX) {
+                    SUGGESTED_NODE(service, following)->prev = prev_suggested;
+                }
+                if (current_user->suggestedTail == suggested) {
+                    current_user->suggestedTail = prev_suggested;
                 }
+                node_pool_free(&service->suggestedPool, suggested);
+                mem_stats_free(&service->memStats, MEM_SUGGESTED_LISTS, sizeof(struct suggested_movie));
+                current_user->suggestedCount--;
+            } else {
+                prev_suggested = suggested;
+            }
+            suggested = following;
+        }
+    }
+
+    /* Step 2: Remove the movies from the category lists, in one pass per list, the next version stays unpublished */
+    memcpy(next, lists, CATEGORY_LISTS_SIZE(service->categoryCount));
+    for (i = 0; i < service->categoryCount; i++) {
+        if (remove_from_category(service, &doomed, lists->heads[i], i, &categoryRecords, &next->heads[i]) > 0) {
+            changed = 1;
+        }
+    }
+    group_takeoff_records(&userRecords, count, userStarts);
+    group_takeoff_records(&categoryRecords, count, categoryStarts);
 
-                printf("%u removed from %s category list.\n", mid, get_category_name(i));
-                position = i;        
-                break;
+    /* Step 3: Report every T event as if it ran alone, the published lists still hold the removed movies */
+    for (j = 0; j < count; j++) {
+        int position = -1;
+        fprintf(service->out, "T %u\n", mids[j]);
+        for (r = userStarts[j]; r < userStarts[j + 1]; r++) {
+            fprintf(service->out, "%u removed from %u suggested list.\n", mids[j], userRecords.items[r].owner);
+        }
+        for (r = categoryStarts[j]; r < categoryStarts[j + 1]; r++) {
+            position = categoryRecords.items[r].owner;
+            fprintf(service->out, "%u removed from %s category list.\n", mids[j], service_get_category_name(service, position));
+        }
+        watch_stats_retire(&service->watchStats, mids[j]);
+        cowatch_remove_movie(&service->coWatch, mids[j]);
+
+        /* Printing the remaining movies in the category list */
+        fprintf(service->out, "Category list %d = ", position);
+        if (position >= 0) {
+            uint32_t temp_movie = lists->heads[position];
+            doomed_set_rewind(&doomed);
+            while (temp_movie != NIL_INDEX) {
+                unsigned temp_mid = SLOT_INFO(service, MOVIE_NODE(service, temp_movie)->slot)->mid;
+                uint32_t removal = doomed_removal(&doomed, temp_mid);
+                if (removal == NO_REMOVAL || removal > j) {
+                    fprintf(service->out, "%u, ", temp_mid);
+                }
+                temp_movie = MOVIE_NODE(service, temp_movie)->next;
             }
+        }
+        fprintf(service->out, "\nDONE\n");
+    }
+
+done:
+    if (changed) {
+        publish_category_lists(service, next);
+    } else {
+        free(next);
+    }
+    free(userRecords.items);
+    free(userRecords.spare);
+    free(categoryRecords.items);
+    free(categoryRecords.spare);
+    free(userStarts);
+    free(categoryStarts);
+    doomed_set_destroy(&doomed);
+}
+
+/*Event K- Function to print the most watched movies, overall or of one category*/
+int service_most_watched_movies(struct streaming_service *service, unsigned k, int category) {
+    int ranking = category == ALL_CATEGORIES ? RANK_ALL : RANK_OF_CATEGORY(category);
+    unsigned n, i;
 
-            prev_movie = current_movie;
-            current_movie = current_movie->next;
+    if (category == ALL_CATEGORIES) {
+        fprintf(service->out, "K %u\n", k);
+    } else {
+        fprintf(service->out, "K %u %d\n", k, category);
+    }
+    if (category != ALL_CATEGORIES && (category < 0 || category >= service->categoryCount)) {
+        fprintf(service->out, "Category %d does not exist\n", category);
+        return -1;
+    }
+
+    /*No more than one line per counted movie*/
+    if (k > service->watchStats.entries.live) {
+        k = service->watchStats.entries.live;
+    }
+    struct watch_count *top = (struct watch_count *)malloc((k ? k : 1) * sizeof(struct watch_count));
+    if (top == NULL) {
+        return -1;
+    }
+    n = watch_stats_top(&service->watchStats, ranking, k, top);
+
+    fprintf(service->out, "%s Most Watched = ", category == ALL_CATEGORIES ? "All" : service_get_category_name(service, category));
+    for (i = 0; i < n; i++) {
+        fprintf(service->out, "<%u,%u>", top[i].mid, top[i].count);
+        if (i + 1 < n) {
+            fprintf(service->out, ", ");
         }
     }
-    /* Printing the remaining movies in the category list */
-    printf("Category list %d = ", position);
-    struct movie* temp_movie = categoryLists[position];
-    while (temp_movie != NULL) {
-        printf("%u, ", temp_movie->info.mid);
-        temp_movie = temp_movie->next;
+    fprintf(service->out, "\nDONE\n");
+    free(top);
+    return 0;
+}
+
+/*The function prints the memory used by every structure, followed by the peak resident set size*/
+void service_print_memory_usage(struct streaming_service *service, FILE *out) {
+    struct rusage usage;
+    int kind;
+
+    for (kind = 0; kind < MEM_KIND_COUNT; kind++) {
+        const struct mem_counter *counter = &service->memStats.kinds[kind];
+        fprintf(out, "%s: %zu nodes, %zu bytes (peak %zu nodes, %zu bytes)\n", mem_kind_name(kind),
+                counter->nodes, counter->bytes, counter->peakNodes, counter->peakBytes);
+    }
+
+    /*Structures sized from their own state*/
+    fprintf(out, "User Table: %u users, %u records, %zu bytes\n", service->userTable.live, service->userTable.used - 1,
+            user_table_bytes(&service->userTable));
+    fprintf(out, "Movie Catalog: %u slots, %zu bytes\n", service->movieCatalog.slots.live,
+            (size_t)service->movieCatalog.slots.live * sizeof(struct movie_info)
+            + ((size_t)service->movieCatalog.bucketMask + 1) * sizeof(uint32_t));
+    fprintf(out, "Watch Counters: %u movies, %zu bytes\n", service->watchStats.entries.live,
+            (size_t)service->watchStats.entries.live * sizeof(struct watch_entry)
+            + (size_t)service->watchStats.buckets.live * sizeof(struct watch_bucket)
+            + ((size_t)service->watchStats.tableMask + 1) * sizeof(uint32_t));
+    fprintf(out, "Co-watch Matrix: %zu cells, %zu pruned, %zu bytes\n", service->coWatch.cellCount, service->coWatch.prunedCells,
+            cowatch_bytes(&service->coWatch));
+    if (service->suggestedCap > 0) {
+        fprintf(out, "Suggested List Cap: %u movies, %zu evicted\n", service->suggestedCap, service->suggestedEvictions);
+    } else {
+        fprintf(out, "Suggested List Cap: none\n");
+    }
+
+    /*Capacity reserved by the node pools, used or not*/
+    fprintf(out, "Node Pools: %zu bytes reserved\n",
+            (size_t)service->moviePool.chunkCount * POOL_CHUNK_SIZE * service->moviePool.elemSize
+            + (size_t)service->suggestedPool.chunkCount * POOL_CHUNK_SIZE * service->suggestedPool.elemSize);
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        fprintf(out, "Peak RSS: %ld kB\n", usage.ru_maxrss);
     }
-    printf("\nDONE\n");
+}
+
+/*Event Q- Function to print the memory report*/
+void service_print_memory(struct streaming_service *service) {
+    fprintf(service->out, "Q\nMemory:\n");
+    service_print_memory_usage(service, service->out);
+    fprintf(service->out, "DONE\n");
 }
 
 /*Event M- Function to print information about movies in category lists*/
-void print_movies(void) {
-    printf("M\nCategorized Movies:\n");
-    print_categorized_movies();
+void service_print_movies(struct streaming_service *service) {
+    service_print_movies_snapshot(service, service_current_category_lists(service), service->out);
+}
+
+/*Event M on a pinned snapshot- Function to print the movies of one version of the category lists to out*/
+void service_print_movies_snapshot(struct streaming_service *service, const struct category_lists *lists, FILE *out) {
+    fprintf(out, "M\nCategorized Movies:\n");
+    print_categorized_movies(service, out, lists);
+}
+
+/*The function pins the current category lists so that they can be read without any lock*/
+int service_category_snapshot_pin(struct streaming_service *service, struct category_snapshot *snapshot) {
+    snapshot->slot = epoch_pin(&service->categoryEpoch);
+    if (snapshot->slot < 0) {
+        return -1;
+    }
+    snapshot->lists = atomic_load_explicit(&service->categoryLists, memory_order_acquire);
+    return 0;
+}
+
+/*The function releases a pinned snapshot, its retired nodes can be reclaimed afterwards*/
+void service_category_snapshot_unpin(struct streaming_service *service, struct category_snapshot *snapshot) {
+    epoch_unpin(&service->categoryEpoch, snapshot->slot);
+    snapshot->slot = -1;
+    snapshot->lists = NULL;
 }
 
 /*Event P- Function to print information about users and their suggested movies and watch history*/
-void print_users() {
-    printf("P\nUsers:\n");
+void service_print_users(struct streaming_service *service) {
+    fprintf(service->out, "P\nUsers:\n");
 
-    struct user* current = userList;
-    while (current-> uid != SENTINEL_UID) {
-        printf("<%d>:\nSuggested: ", current->uid);
+    uint32_t handle;
+    for (handle = service->userTable.newest; handle != NIL_INDEX; handle = USER_RECORD(service, handle)->older) {
+        struct user *current = USER_RECORD(service, handle);
+        fprintf(service->out, "<%d>:\nSuggested: ", current->uid);
 
         /*Print suggested movies*/
-        struct suggested_movie* suggested = current->suggestedHead;
-        while (suggested != NULL) {
-            printf("<%u,%d>, ", suggested->info.mid, suggested->info.year);
-            suggested = suggested->next;
+        uint32_t suggested = current->suggestedHead;
+        while (suggested != NIL_INDEX) {
+            const struct movie_info *info = SLOT_INFO(service, SUGGESTED_NODE(service, suggested)->slot);
+            fprintf(service->out, "<%u,%d>, ", info->mid, info->year);
+            suggested = SUGGESTED_NODE(service, suggested)->next;
         }
 
         /*Print watch history*/
-        printf("\nWatch History: ");
-        struct movie* watchHistory = current->watchHistory;
-        while (watchHistory != NULL) {
-            printf("<%u,%d>, ", watchHistory->info.mid, watchHistory->info.year);
-            watchHistory = watchHistory->next;
+        fprintf(service->out, "\nWatch History: ");
+        uint32_t watchHistory = current->watchHistory;
+        while (watchHistory != NIL_INDEX) {
+            const struct movie_info *info = SLOT_INFO(service, MOVIE_NODE(service, watchHistory)->slot);
+            fprintf(service->out, "<%u,%d>, ", info->mid, info->year);
+            watchHistory = MOVIE_NODE(service, watchHistory)->next;
         }
 
-        printf("\n");
-        current = current->next;
+        fprintf(service->out, "\n");
     }
 
-    printf("DONE\n");
+    fprintf(service->out, "DONE\n");
 }
@@ -15,12 +15,35 @@
 #ifndef __CS240_STREAMING_SERVICE_H__
 #define __CS240_STREAMING_SERVICE_H__
 
-/* number of distinct movie categories */
-#define CATEGORY_COUNT 6
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
 
-/* value used for the sentinel user node */
-#define SENTINEL_UID (-1)
+#include "epoch.h"
+#include "mem_stats.h"
+#include "node_pool.h"
+#include "movie_catalog.h"
+#include "user_table.h"
+#include "watch_stats.h"
+#include "cowatch.h"
 
+/* number of categories when no category file is given */
+#define DEFAULT_CATEGORY_COUNT 6
+
+/* upper bound on the number of categories of a category file */
+#define MAX_CATEGORY_COUNT 65536
+
+/* longest category name read from a category file */
+#define MAX_CATEGORY_NAME 128
+
+/* category argument of event K selecting every category */
+#define ALL_CATEGORIES (-1)
+
+/*
+ * The built-in categories, in the order of the default
+ * category table. A category file replaces the table,
+ * categories are then numbered from 0 in file order
+ */
 typedef enum {
 	HORROR,
 	SCIFI,
@@ -35,9 +58,15 @@ struct movie_info {
 	unsigned year;
 };
 
+/*
+ * List nodes live in pooled arrays and are linked
+ * by 32-bit indices (NIL_INDEX ends a list). Their
+ * movie information is interned in movieCatalog and
+ * referenced by slot index.
+ */
 struct movie {
-	struct movie_info info;
-	struct movie *next;
+	uint32_t slot;
+	uint32_t next;
 };
 
 struct new_movie {
@@ -47,22 +76,90 @@ struct new_movie {
 };
 
 struct suggested_movie {
-	struct movie_info info;
-	struct suggested_movie *prev;
-	struct suggested_movie *next;
+	uint32_t slot;
+	uint32_t prev;
+	uint32_t next;
+};
+
+/*
+ * One published version of the per-category sorted
+ * movie lists. A published version and the nodes it
+ * reaches are never modified: D and T build the next
+ * version aside, sharing the untouched list suffixes,
+ * publish it at once and retire what became unreachable
+ * through the categoryEpoch of their service. Readers on other threads pin
+ * a snapshot and traverse it without any lock.
+ */
+struct category_lists {
+	int count;        /* categories, categoryCount */
+	uint32_t heads[]; /* one list per category */
 };
 
-struct user {
-	int uid;
-	struct suggested_movie *suggestedHead;
-	struct suggested_movie *suggestedTail;
-	struct movie *watchHistory;
-	struct user *next;
+/* bytes of a category_lists version of count categories */
+#define CATEGORY_LISTS_SIZE(count) (sizeof(struct category_lists) + (size_t)(count) * sizeof(uint32_t))
+
+/* a version of the category lists held by a reader */
+struct category_snapshot {
+	int slot;
+	const struct category_lists *lists;
 };
 
-extern struct user *userList;
-extern struct new_movie *newMoviesList;
-extern struct movie *categoryLists[CATEGORY_COUNT];
+/* movies of a filtered search merged ahead of its event */
+struct suggestion_merge {
+	uint32_t *slots;	/* catalog slots, sorted by movie ID */
+	unsigned count;
+	int failed;		/* the merge ran out of memory, slots holds what it collected */
+};
+
+/*
+ * One instance of the streaming service. It owns every
+ * list, allocator and counter of the instance and shares
+ * nothing mutable with other instances, so that separate
+ * instances can run on separate threads. A new instance
+ * must start zeroed, e.g. declared with = {0}
+ */
+struct streaming_service {
+	struct user_table userTable;
+	struct new_movie *newMoviesList;
+	/* number of categories and their names, set once before init */
+	int categoryCount;
+	char **categoryNames;
+	struct category_lists *_Atomic categoryLists;
+	struct epoch_domain categoryEpoch;
+	/* storage for struct movie and struct suggested_movie nodes */
+	struct node_pool moviePool;
+	struct node_pool suggestedPool;
+	struct movie_catalog movieCatalog;
+	/* per-movie watch counters kept up to date by W, D and T */
+	struct watch_stats watchStats;
+	/* co-watch counts of recently watched titles, kept up to date by W and T */
+	struct cowatch_matrix coWatch;
+	/* per-structure memory counters, updated on every allocation and free */
+	struct mem_stats memStats;
+	/* most movies kept in a suggested list, 0 for no limit, set before use */
+	unsigned suggestedCap;
+	/* suggestions dropped to keep lists under suggestedCap */
+	size_t suggestedEvictions;
+	/* cell budget of the co-watch matrix, 0 for COWATCH_DEFAULT_MAX_CELLS, set before init */
+	size_t cowatchCells;
+	/* stream the events print to, stdout unless set before init */
+	FILE *out;
+};
+
+#define MOVIE_NODE(service, idx) ((struct movie *)node_pool_at(&(service)->moviePool, (idx)))
+#define SUGGESTED_NODE(service, idx) ((struct suggested_movie *)node_pool_at(&(service)->suggestedPool, (idx)))
+#define SLOT_INFO(service, slot) movie_catalog_info(&(service)->movieCatalog, (slot))
+#define USER_RECORD(service, handle) user_table_at(&(service)->userTable, (handle))
+
+/*
+ * Sets up empty users, new movies and category
+ * lists along with the pools, catalog and counters.
+ * The category table must be loaded first
+ */
+void service_init_structures(struct streaming_service *service);
+
+/* Releases everything service_init_structures set up */
+void service_destroy_structures(struct streaming_service *service);
 
 /*
  * Register User - Event R
@@ -76,7 +173,7 @@ extern struct movie *categoryLists[CATEGORY_COUNT];
  * failure (user ID already exists,
  * malloc or other error)
  */
-int register_user(int uid);
+int service_register_user(struct streaming_service *service, int uid);
 
 /*
  * Unregister User - Event U
@@ -87,7 +184,7 @@ int register_user(int uid);
  * user's suggested movie list and
  * watch history stack
  */
-void unregister_user(int uid);
+void service_unregister_user(struct streaming_service *service, int uid);
 
 /*
  * Add new movie - Event A
@@ -97,11 +194,12 @@ void unregister_user(int uid);
  * to new movies list. The new movies
  * list must remain sorted (increasing
  * order based on movie ID) after every
- * insertion.
+ * insertion. A category missing from the
+ * category table is rejected.
  *
  * Returns 0 on success, -1 on failure
  */
-int add_new_movie(unsigned mid, movieCategory_t category, unsigned year);
+int service_add_new_movie(struct streaming_service *service, unsigned mid, movieCategory_t category, unsigned year);
 
 /*
  * Distribute new movies - Event D
@@ -114,7 +212,7 @@ int add_new_movie(unsigned mid, movieCategory_t category, unsigned year);
  * O(n) time complexity, where n is the size
  * of the new movies list
  */
-void distribute_new_movies(void);
+void service_distribute_new_movies(struct streaming_service *service);
 
 /*
  * User watches movie - Event W
@@ -127,7 +225,7 @@ void distribute_new_movies(void);
  * Returns 0 on success, -1 on failure
  * (user/movie does not exist, malloc error)
  */
-int watch_movie(int uid, unsigned mid);
+int service_watch_movie(struct streaming_service *service, int uid, unsigned mid);
 
 /*
  * Suggest movies to user - Event S
@@ -142,11 +240,15 @@ int watch_movie(int uid, unsigned mid);
  * once from user uid's suggestedTail pointer
  * and following prev pointers. This event
  * should be implemented with time complexity
- * O(n), where n is the size of the users list
+ * O(n), where n is the size of the users list.
+ * A list capped by suggestedCap drops its tail
+ * for a head side suggestion and its head for a
+ * tail side one; F, G and C, which append, drop
+ * the head
  *
  * Returns 0 on success, -1 on failure
  */
-int suggest_movies(int uid);
+int service_suggest_movies(struct streaming_service *service, int uid);
 
 /*
  * Filtered movie search - Event F
@@ -162,7 +264,62 @@ int suggest_movies(int uid);
  *
  * Returns 0 on success, -1 on failure
  */
-int filtered_movie_search(int uid, movieCategory_t category1, movieCategory_t category2, unsigned year);
+int service_filtered_movie_search(struct streaming_service *service, int uid, movieCategory_t category1, movieCategory_t category2, unsigned year);
+
+/*
+ * Multi-category movie search - Event G
+ *
+ * Like event F for any number of categories:
+ * user uid is suggested the movies of the count
+ * categories with release year >= year, sorted by
+ * increasing movie ID. The category lists are
+ * combined by a single heap based k-way merge in
+ * O(N log k) time, where N is the total size of
+ * the k lists. Categories out of range are ignored
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int service_multi_category_search(struct streaming_service *service, int uid, const int *categories, unsigned count, unsigned year);
+
+/*
+ * Merges the movies of count categories of lists with
+ * release year >= year into merge, as events F and G
+ * do. It allocates no list node, so it is safe on any
+ * thread that pinned lists. Release merge with
+ * service_suggestion_merge_free.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int service_merge_suggestions(struct streaming_service *service, const struct category_lists *lists,
+		const int *categories, unsigned count, unsigned year, struct suggestion_merge *merge);
+
+/* Releases the movies of a merge */
+void service_suggestion_merge_free(struct suggestion_merge *merge);
+
+/*
+ * Events F and G, given the merge of their categories
+ * on the current version of the category lists, which
+ * only has to be spliced into the user's suggested
+ * movies. A NULL merge is done by the event itself
+ */
+int service_filtered_movie_search_merged(struct streaming_service *service, int uid, movieCategory_t category1,
+		movieCategory_t category2, unsigned year, const struct suggestion_merge *merged);
+int service_multi_category_search_merged(struct streaming_service *service, int uid, const int *categories,
+		unsigned count, unsigned year, const struct suggestion_merge *merged);
+
+/*
+ * Co-watch movie suggestions - Event C
+ *
+ * User uid is suggested up to n movies most often
+ * watched together with the user's COWATCH_WINDOW
+ * most recent titles, as counted by watch_movie in
+ * the co-watch matrix. They are appended to the
+ * user's suggested movies list, most co-watched
+ * first. No other user is scanned
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int service_cowatch_suggest_movies(struct streaming_service *service, int uid, unsigned n);
 
 /*
  * Take off movie - Event T
@@ -171,7 +328,95 @@ int filtered_movie_search(int uid, movieCategory_t category1, movieCategory_t ca
  * from every user's suggested list -if present- and
  * from the corresponding category list.
  */
-void take_off_movie(unsigned mid);
+void service_take_off_movie(struct streaming_service *service, unsigned mid);
+
+/*
+ * Take off movies - batch of T events
+ *
+ * Same effect and output as count take_off_movie
+ * calls in a row, mids may repeat. The doomed movies
+ * go in a hash set, then every suggested list and
+ * category list is swept once, so a burst costs
+ * O(users' suggestions + category lists + count)
+ * instead of that much per movie
+ */
+void service_take_off_movies(struct streaming_service *service, const unsigned *mids, unsigned count);
+
+/*
+ * Most watched movies - Event K
+ *
+ * Prints the k movies with the most watches,
+ * over all movies when category is ALL_CATEGORIES,
+ * otherwise over the movies of category. Counters
+ * are maintained incrementally by watch_movie and
+ * dropped by take_off_movie, so this event runs
+ * in O(k) time independent of the number of users
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int service_most_watched_movies(struct streaming_service *service, unsigned k, int category);
+
+/*
+ * Memory report - Event Q
+ *
+ * Prints the nodes and bytes currently used,
+ * and their peaks, by users, watch histories,
+ * suggested movies lists, new movies and
+ * category lists, the footprint of the catalog,
+ * watch counters and co-watch matrix, and the
+ * peak resident set size of the process
+ */
+void service_print_memory(struct streaming_service *service);
+
+/*
+ * Prints the same report as event Q to out,
+ * also used for the report at exit
+ */
+void service_print_memory_usage(struct streaming_service *service, FILE *out);
+
+/*
+ * Reads the category table from path, one name per
+ * line, blank lines and lines starting with # skipped.
+ * A NULL path loads the DEFAULT_CATEGORY_COUNT
+ * built-in categories. Must run before
+ * service_init_structures
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int service_load_category_names(struct streaming_service *service, const char *path);
+
+/* Releases the category table */
+void service_free_category_names(struct streaming_service *service);
+
+/* Returns the name of category, "Unknown" if out of range */
+const char *service_get_category_name(struct streaming_service *service, int category);
+
+/*
+ * Returns the current version of the category lists.
+ * Only the thread executing the events may use it
+ * without pinning a snapshot
+ */
+const struct category_lists *service_current_category_lists(struct streaming_service *service);
+
+/*
+ * Pins the current version of the category lists, from
+ * any thread. It stays valid, and unchanged, until
+ * category_snapshot_unpin, however many D and T events
+ * run meanwhile.
+ *
+ * Returns 0 on success, -1 if too many snapshots are pinned
+ */
+int service_category_snapshot_pin(struct streaming_service *service, struct category_snapshot *snapshot);
+
+/* Releases a snapshot pinned by category_snapshot_pin */
+void service_category_snapshot_unpin(struct streaming_service *service, struct category_snapshot *snapshot);
+
+/*
+ * Prints the output of event M for the given version
+ * of the category lists to out. Safe on any thread
+ * holding a snapshot of lists
+ */
+void service_print_movies_snapshot(struct streaming_service *service, const struct category_lists *lists, FILE *out);
 
 /*
  * Print movies - Event M
@@ -179,7 +424,7 @@ void take_off_movie(unsigned mid);
  * Prints information on movies in
  * per-category lists
  */
-void print_movies(void);
+void service_print_movies(struct streaming_service *service);
 
 /*
  * Print users - Event P
@@ -187,5 +432,42 @@ void print_movies(void);
  * Prints information on users in
  * users list
  */
+void service_print_users(struct streaming_service *service);
+
+/*
+ * Compatibility API: every function above without its
+ * service argument, working on the process wide
+ * defaultService as the service used to be global.
+ * init_structures loads the built-in category table
+ * unless one was loaded before, and destroy_structures
+ * releases the table init_structures loaded
+ */
+extern struct streaming_service defaultService;
+
+void init_structures(void);
+void destroy_structures(void);
+int register_user(int uid);
+void unregister_user(int uid);
+int add_new_movie(unsigned mid, movieCategory_t category, unsigned year);
+void distribute_new_movies(void);
+int watch_movie(int uid, unsigned mid);
+int suggest_movies(int uid);
+int filtered_movie_search(int uid, movieCategory_t category1, movieCategory_t category2, unsigned year);
+int multi_category_search(int uid, const int *categories, unsigned count, unsigned year);
+int cowatch_suggest_movies(int uid, unsigned n);
+void take_off_movie(unsigned mid);
+void take_off_movies(const unsigned *mids, unsigned count);
+int most_watched_movies(unsigned k, int category);
+void print_memory(void);
+void print_memory_usage(FILE *out);
+int load_category_names(const char *path);
+void free_category_names(void);
+const char *get_category_name(int category);
+const struct category_lists *current_category_lists(void);
+int category_snapshot_pin(struct category_snapshot *snapshot);
+void category_snapshot_unpin(struct category_snapshot *snapshot);
+void print_movies_snapshot(const struct category_lists *lists, FILE *out);
+void print_movies(void);
 void print_users(void);
+
 #endif
@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include "open_hash.h"
+#include "user_table.h"
+
+/*initial number of records and of buckets, must be powers of two*/
+#define USER_TABLE_INITIAL_RECORDS 64
+#define USER_TABLE_INITIAL_BUCKETS 128
+
+static uint32_t bucket_hash(const void *bucket, const void *context) {
+    const struct user_table *table = (const struct user_table *)context;
+    return hash_u32((uint32_t)table->records[*(const uint32_t *)bucket].uid);
+}
+
+static int bucket_matches(const void *bucket, const void *key, const void *context) {
+    const struct user_table *table = (const struct user_table *)context;
+    return table->records[*(const uint32_t *)bucket].uid == *(const int *)key;
+}
+
+/*buckets hold handles, the table stays under half full*/
+static const struct open_hash_type bucketType = {
+    sizeof(uint32_t), 2, bucket_hash, bucket_matches, open_hash_index_empty
+};
+
+int user_table_init(struct user_table *table) {
+    table->records = (struct user *)malloc(USER_TABLE_INITIAL_RECORDS * sizeof(struct user));
+    table->buckets = (uint32_t *)calloc(USER_TABLE_INITIAL_BUCKETS, sizeof(uint32_t));
+    if (table->records == NULL || table->buckets == NULL) {
+        free(table->records);
+        free(table->buckets);
+        return -1;
+    }
+    table->used = 1; /*record 0 stands for NIL_INDEX*/
+    table->cap = USER_TABLE_INITIAL_RECORDS;
+    table->freeHead = NIL_INDEX;
+    table->newest = NIL_INDEX;
+    table->live = 0;
+    table->bucketMask = USER_TABLE_INITIAL_BUCKETS - 1;
+    return 0;
+}
+
+void user_table_destroy(struct user_table *table) {
+    free(table->records);
+    free(table->buckets);
+    table->records = NULL;
+    table->buckets = NULL;
+    table->used = table->cap = table->live = 0;
+    table->freeHead = table->newest = NIL_INDEX;
+    table->bucketMask = 0;
+}
+
+/*Position of uid in the lookup table, or of the empty bucket where it would go*/
+static uint32_t bucket_position(const struct user_table *table, int uid) {
+    return open_hash_probe(&bucketType, table, table->buckets, table->bucketMask, hash_u32((uint32_t)uid), &uid);
+}
+
+uint32_t user_table_find(const struct user_table *table, int uid) {
+    return table->buckets[bucket_position(table, uid)];
+}
+
+uint32_t user_table_add(struct user_table *table, int uid) {
+    struct user *record;
+    uint32_t *buckets, handle;
+
+    buckets = (uint32_t *)open_hash_reserve(&bucketType, table, table->buckets, &table->bucketMask, table->live);
+    if (buckets == NULL) {
+        return NIL_INDEX;
+    }
+    table->buckets = buckets;
+
+    if (table->freeHead != NIL_INDEX) {
+        handle = table->freeHead;
+        table->freeHead = table->records[handle].older;
+    } else {
+        if (table->used == table->cap) {
+            struct user *grown = (struct user *)realloc(table->records, (size_t)table->cap * 2 * sizeof(struct user));
+            if (grown == NULL) {
+                return NIL_INDEX;
+            }
+            table->records = grown;
+            table->cap *= 2;
+        }
+        handle = table->used++;
+    }
+
+    record = &table->records[handle];
+    record->uid = uid;
+    record->suggestedHead = NIL_INDEX;
+    record->suggestedTail = NIL_INDEX;
+    record->suggestedCount = 0;
+    record->watchHistory = NIL_INDEX;
+    record->older = table->newest;
+    record->newer = NIL_INDEX;
+    if (table->newest != NIL_INDEX) {
+        table->records[table->newest].newer = handle;
+    }
+    table->newest = handle;
+    table->buckets[bucket_position(table, uid)] = handle;
+    table->live++;
+    return handle;
+}
+
+void user_table_remove(struct user_table *table, uint32_t handle) {
+    struct user *record = &table->records[handle];
+    uint32_t pos = bucket_position(table, record->uid);
+
+    open_hash_remove(&bucketType, table, table->buckets, table->bucketMask, pos);
+
+    /*Unlink from the registration order*/
+    if (record->newer != NIL_INDEX) {
+        table->records[record->newer].older = record->older;
+    } else {
+        table->newest = record->older;
+    }
+    if (record->older != NIL_INDEX) {
+        table->records[record->older].newer = record->newer;
+    }
+
+    record->older = table->freeHead;
+    table->freeHead = handle;
+    table->live--;
+}
+
+size_t user_table_bytes(const struct user_table *table) {
+    return (size_t)table->cap * sizeof(struct user) + ((size_t)table->bucketMask + 1) * sizeof(uint32_t);
+}
@@ -0,0 +1,74 @@
+/*
+ * ============================================
+ * file: user_table.h
+ *
+ * @brief Users stored as fixed-size records of one
+ *        growable array. A user keeps the handle of its
+ *        record, its index, from registration to
+ *        unregistration; freed records are reused by
+ *        later registrations. The records are linked in
+ *        registration order, so that sweeping every user
+ *        walks the array instead of scattered nodes.
+ * ============================================
+ */
+
+#ifndef __USER_TABLE_H__
+#define __USER_TABLE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "node_pool.h"
+
+struct user {
+    int uid;
+    uint32_t suggestedHead;
+    uint32_t suggestedTail;
+    uint32_t suggestedCount;
+    uint32_t watchHistory;
+    uint32_t older;     /* user registered just before, or next free record */
+    uint32_t newer;     /* user registered just after */
+};
+
+struct user_table {
+    struct user *records;   /* records[0] is unused, NIL_INDEX is never a handle */
+    uint32_t used;          /* records handed out so far, freed ones included */
+    uint32_t cap;
+    uint32_t freeHead;      /* freed records, linked by older */
+    uint32_t newest;        /* first user of a sweep, the next ones follow older */
+    uint32_t live;
+    uint32_t *buckets;      /* open addressing table of handles on uid, NIL_INDEX when empty */
+    uint32_t bucketMask;    /* bucket count - 1, the count is a power of two */
+};
+
+/*
+ * Prepares an empty table.
+ * Returns 0 on success, -1 on failure
+ */
+int user_table_init(struct user_table *table);
+
+/* Releases the records and the lookup table */
+void user_table_destroy(struct user_table *table);
+
+/* Returns the handle of user uid, NIL_INDEX if not registered */
+uint32_t user_table_find(const struct user_table *table, int uid);
+
+/*
+ * Registers uid, which must not be registered yet, as
+ * the newest user with empty lists. Returns its handle,
+ * or NIL_INDEX on allocation failure. Pointers to records
+ * are invalidated, handles are not
+ */
+uint32_t user_table_add(struct user_table *table, int uid);
+
+/* Unregisters the user of handle, its lists must be released first */
+void user_table_remove(struct user_table *table, uint32_t handle);
+
+/* Bytes held by the records and the lookup table */
+size_t user_table_bytes(const struct user_table *table);
+
+/* Record of handle */
+static inline struct user *user_table_at(const struct user_table *table, uint32_t handle) {
+    return &table->records[handle];
+}
+
+#endif
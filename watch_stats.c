@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include "open_hash.h"
+#include "watch_stats.h"
+
+/*initial size of the mid lookup table, must be a power of two*/
+#define STATS_INITIAL_TABLE 256
+
+#define ENTRY(stats, idx) ((struct watch_entry *)node_pool_at(&(stats)->entries, (idx)))
+#define BUCKET(stats, idx) ((struct watch_bucket *)node_pool_at(&(stats)->buckets, (idx)))
+
+/*The overall ranking uses the first links of an entry, the category ranking the second*/
+static int ranking_link(int ranking) {
+    return ranking == RANK_ALL ? 0 : 1;
+}
+
+static uint32_t table_hash(const void *slot, const void *context) {
+    return hash_u32(ENTRY((const struct watch_stats *)context, *(const uint32_t *)slot)->mid);
+}
+
+static int table_matches(const void *slot, const void *key, const void *context) {
+    return ENTRY((const struct watch_stats *)context, *(const uint32_t *)slot)->mid == *(const unsigned *)key;
+}
+
+/*the lookup table holds entry indices and stays under half full*/
+static const struct open_hash_type tableType = {
+    sizeof(uint32_t), 2, table_hash, table_matches, open_hash_index_empty
+};
+
+int watch_stats_init(struct watch_stats *stats, int categoryCount) {
+    int i;
+    stats->table = NULL;
+    stats->rankings = NULL;
+    if (node_pool_init(&stats->entries, sizeof(struct watch_entry)) != 0) {
+        return -1;
+    }
+    if (node_pool_init(&stats->buckets, sizeof(struct watch_bucket)) != 0) {
+        node_pool_destroy(&stats->entries);
+        return -1;
+    }
+    stats->table = (uint32_t *)calloc(STATS_INITIAL_TABLE, sizeof(uint32_t));
+    stats->rankingCount = categoryCount + 1;
+    stats->rankings = (struct watch_ranking *)malloc(stats->rankingCount * sizeof(struct watch_ranking));
+    if (stats->table == NULL || stats->rankings == NULL) {
+        watch_stats_destroy(stats);
+        return -1;
+    }
+    stats->tableMask = STATS_INITIAL_TABLE - 1;
+    stats->tableUsed = 0;
+    for (i = 0; i < stats->rankingCount; i++) {
+        stats->rankings[i].lowest = NIL_INDEX;
+        stats->rankings[i].highest = NIL_INDEX;
+    }
+    return 0;
+}
+
+void watch_stats_destroy(struct watch_stats *stats) {
+    free(stats->table);
+    free(stats->rankings);
+    stats->table = NULL;
+    stats->rankings = NULL;
+    stats->tableMask = 0;
+    stats->tableUsed = 0;
+    stats->rankingCount = 0;
+    node_pool_destroy(&stats->entries);
+    node_pool_destroy(&stats->buckets);
+}
+
+/*Position of mid in the lookup table, or of the empty bucket where it would go*/
+static uint32_t table_position(const struct watch_stats *stats, unsigned mid) {
+    return open_hash_probe(&tableType, stats, stats->table, stats->tableMask, hash_u32(mid), &mid);
+}
+
+/*Create an empty bucket right above lower (at the bottom if lower is NIL_INDEX)*/
+static uint32_t bucket_insert_above(struct watch_stats *stats, int ranking, uint32_t lower, uint32_t count) {
+    struct watch_ranking *rank = &stats->rankings[ranking];
+    uint32_t idx = node_pool_alloc(&stats->buckets);
+    struct watch_bucket *bucket;
+    if (idx == NIL_INDEX) {
+        return NIL_INDEX;
+    }
+    bucket = BUCKET(stats, idx);
+    bucket->count = count;
+    bucket->head = NIL_INDEX;
+    bucket->tail = NIL_INDEX;
+    bucket->lower = lower;
+    bucket->higher = lower != NIL_INDEX ? BUCKET(stats, lower)->higher : rank->lowest;
+    if (lower != NIL_INDEX) {
+        BUCKET(stats, lower)->higher = idx;
+    } else {
+        rank->lowest = idx;
+    }
+    if (bucket->higher != NIL_INDEX) {
+        BUCKET(stats, bucket->higher)->lower = idx;
+    } else {
+        rank->highest = idx;
+    }
+    return idx;
+}
+
+static void bucket_remove(struct watch_stats *stats, int ranking, uint32_t idx) {
+    struct watch_ranking *rank = &stats->rankings[ranking];
+    struct watch_bucket *bucket = BUCKET(stats, idx);
+    if (bucket->lower != NIL_INDEX) {
+        BUCKET(stats, bucket->lower)->higher = bucket->higher;
+    } else {
+        rank->lowest = bucket->higher;
+    }
+    if (bucket->higher != NIL_INDEX) {
+        BUCKET(stats, bucket->higher)->lower = bucket->lower;
+    } else {
+        rank->highest = bucket->lower;
+    }
+    node_pool_free(&stats->buckets, idx);
+}
+
+/*Append entry e at the tail of bucket b*/
+static void entry_link(struct watch_stats *stats, int ranking, uint32_t e, uint32_t b) {
+    int l = ranking_link(ranking);
+    struct watch_entry *entry = ENTRY(stats, e);
+    struct watch_bucket *bucket = BUCKET(stats, b);
+    entry->bucket[l] = b;
+    entry->prev[l] = bucket->tail;
+    entry->next[l] = NIL_INDEX;
+    if (bucket->tail != NIL_INDEX) {
+        ENTRY(stats, bucket->tail)->next[l] = e;
+    } else {
+        bucket->head = e;
+    }
+    bucket->tail = e;
+}
+
+/*Take entry e out of its bucket, dropping the bucket once it is empty*/
+static void entry_unlink(struct watch_stats *stats, int ranking, uint32_t e) {
+    int l = ranking_link(ranking);
+    struct watch_entry *entry = ENTRY(stats, e);
+    uint32_t b = entry->bucket[l];
+    struct watch_bucket *bucket;
+    if (b == NIL_INDEX) {
+        return;
+    }
+    bucket = BUCKET(stats, b);
+    if (entry->prev[l] != NIL_INDEX) {
+        ENTRY(stats, entry->prev[l])->next[l] = entry->next[l];
+    } else {
+        bucket->head = entry->next[l];
+    }
+    if (entry->next[l] != NIL_INDEX) {
+        ENTRY(stats, entry->next[l])->prev[l] = entry->prev[l];
+    } else {
+        bucket->tail = entry->prev[l];
+    }
+    entry->bucket[l] = NIL_INDEX;
+    if (bucket->head == NIL_INDEX) {
+        bucket_remove(stats, ranking, b);
+    }
+}
+
+/*Move entry e from its bucket to the one holding its new count, which is at most one step higher*/
+static int entry_promote(struct watch_stats *stats, int ranking, uint32_t e) {
+    struct watch_entry *entry = ENTRY(stats, e);
+    uint32_t from = entry->bucket[ranking_link(ranking)];
+    uint32_t to = from != NIL_INDEX ? BUCKET(stats, from)->higher : stats->rankings[ranking].lowest;
+    if (to == NIL_INDEX || BUCKET(stats, to)->count != entry->count) {
+        to = bucket_insert_above(stats, ranking, from, entry->count);
+        if (to == NIL_INDEX) {
+            return -1;
+        }
+    }
+    entry_unlink(stats, ranking, e);
+    entry_link(stats, ranking, e, to);
+    return 0;
+}
+
+/*Entry of movie mid, created with no watches if it has none yet*/
+static uint32_t entry_find_or_create(struct watch_stats *stats, unsigned mid) {
+    uint32_t pos = table_position(stats, mid);
+    uint32_t e = stats->table[pos], *table;
+    struct watch_entry *entry;
+
+    if (e != NIL_INDEX) {
+        return e;
+    }
+    table = (uint32_t *)open_hash_reserve(&tableType, stats, stats->table, &stats->tableMask, stats->tableUsed);
+    if (table == NULL) {
+        return NIL_INDEX;
+    }
+    if (table != stats->table) {
+        stats->table = table;
+        pos = table_position(stats, mid);
+    }
+    e = node_pool_alloc(&stats->entries);
+    if (e == NIL_INDEX) {
+        return NIL_INDEX;
+    }
+    entry = ENTRY(stats, e);
+    entry->mid = mid;
+    entry->count = 0;
+    entry->category = UNKNOWN_CATEGORY;
+    entry->slot = NIL_INDEX;
+    entry->bucket[0] = entry->bucket[1] = NIL_INDEX;
+    stats->table[pos] = e;
+    stats->tableUsed++;
+    return e;
+}
+
+int watch_stats_record(struct watch_stats *stats, unsigned mid) {
+    uint32_t e = entry_find_or_create(stats, mid);
+    struct watch_entry *entry;
+
+    if (e == NIL_INDEX) {
+        return -1;
+    }
+    entry = ENTRY(stats, e);
+    entry->count++;
+    if (entry_promote(stats, RANK_ALL, e) != 0) {
+        entry->count--;
+        return -1;
+    }
+    if (entry->category != UNKNOWN_CATEGORY) {
+        if (entry_promote(stats, RANK_OF_CATEGORY(entry->category), e) != 0) {
+            /*keep the two rankings consistent, the movie just stops counting in its category*/
+            entry_unlink(stats, RANK_OF_CATEGORY(entry->category), e);
+            entry->category = UNKNOWN_CATEGORY;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int watch_stats_set_category(struct watch_stats *stats, unsigned mid, int category, uint32_t slot) {
+    int ranking = RANK_OF_CATEGORY(category);
+    uint32_t lower = NIL_INDEX, b, e;
+    struct watch_entry *entry;
+
+    if (category < 0 || ranking >= stats->rankingCount) {
+        return -1;
+    }
+    e = entry_find_or_create(stats, mid);
+    if (e == NIL_INDEX) {
+        return -1;
+    }
+    entry = ENTRY(stats, e);
+    entry->slot = slot;
+    if (entry->category == category) {
+        return 0;
+    }
+    if (entry->category != UNKNOWN_CATEGORY) {
+        entry_unlink(stats, RANK_OF_CATEGORY(entry->category), e);
+    }
+    entry->category = category;
+    if (entry->count == 0) {
+        return 0; /*the first watch will place it*/
+    }
+
+    /*Watched before being distributed, walk up to the bucket of its count*/
+    b = stats->rankings[ranking].lowest;
+    while (b != NIL_INDEX && BUCKET(stats, b)->count < entry->count) {
+        lower = b;
+        b = BUCKET(stats, b)->higher;
+    }
+    if (b == NIL_INDEX || BUCKET(stats, b)->count != entry->count) {
+        b = bucket_insert_above(stats, ranking, lower, entry->count);
+        if (b == NIL_INDEX) {
+            entry->category = UNKNOWN_CATEGORY;
+            return -1;
+        }
+    }
+    entry_link(stats, ranking, e, b);
+    return 0;
+}
+
+uint32_t watch_stats_slot(const struct watch_stats *stats, unsigned mid) {
+    uint32_t e = stats->table[table_position(stats, mid)];
+    return e != NIL_INDEX ? ENTRY(stats, e)->slot : NIL_INDEX;
+}
+
+void watch_stats_retire(struct watch_stats *stats, unsigned mid) {
+    uint32_t pos = table_position(stats, mid);
+    uint32_t e = stats->table[pos];
+    struct watch_entry *entry;
+    if (e == NIL_INDEX) {
+        return;
+    }
+    entry = ENTRY(stats, e);
+    entry_unlink(stats, RANK_ALL, e);
+    if (entry->category != UNKNOWN_CATEGORY) {
+        entry_unlink(stats, RANK_OF_CATEGORY(entry->category), e);
+    }
+    open_hash_remove(&tableType, stats, stats->table, stats->tableMask, pos);
+    stats->tableUsed--;
+    node_pool_free(&stats->entries, e);
+}
+
+unsigned watch_stats_top(const struct watch_stats *stats, int ranking, unsigned k, struct watch_count *top) {
+    int l = ranking_link(ranking);
+    unsigned n = 0;
+    uint32_t b;
+    if (ranking < 0 || ranking >= stats->rankingCount) {
+        return 0;
+    }
+    for (b = stats->rankings[ranking].highest; b != NIL_INDEX && n < k; b = BUCKET(stats, b)->lower) {
+        uint32_t e;
+        for (e = BUCKET(stats, b)->head; e != NIL_INDEX && n < k; e = ENTRY(stats, e)->next[l]) {
+            top[n].mid = ENTRY(stats, e)->mid;
+            top[n].count = ENTRY(stats, e)->count;
+            n++;
+        }
+    }
+    return n;
+}
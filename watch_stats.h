@@ -0,0 +1,105 @@
+/*
+ * ============================================
+ * file: watch_stats.h
+ *
+ * @brief Incremental per-movie watch counters.
+ *        Movies with the same count share a bucket and
+ *        buckets are kept in increasing count order, once
+ *        over all movies and once per category, so the
+ *        most watched movies are read off the highest
+ *        buckets without looking at any user.
+ * ============================================
+ */
+
+#ifndef __WATCH_STATS_H__
+#define __WATCH_STATS_H__
+
+#include <stdint.h>
+#include "node_pool.h"
+
+/* category of a movie that was watched before being distributed */
+#define UNKNOWN_CATEGORY (-1)
+
+/* ranking over all movies, the per-category rankings follow it */
+#define RANK_ALL 0
+#define RANK_OF_CATEGORY(c) ((c) + 1)
+
+/* a movie is linked in the overall ranking and in its category's ranking */
+#define RANK_LINKS 2
+
+struct watch_entry {
+    unsigned mid;
+    uint32_t count;
+    int category;                 /* UNKNOWN_CATEGORY until the movie is distributed */
+    uint32_t slot;                /* catalog slot of the distributed movie, NIL_INDEX before */
+    uint32_t bucket[RANK_LINKS];  /* bucket of the entry in each ranking */
+    uint32_t prev[RANK_LINKS];    /* neighbours inside the bucket */
+    uint32_t next[RANK_LINKS];
+};
+
+struct watch_bucket {
+    uint32_t count;
+    uint32_t head, tail;   /* entries with this count, in the order they reached it */
+    uint32_t lower, higher;
+};
+
+struct watch_ranking {
+    uint32_t lowest, highest;
+};
+
+struct watch_stats {
+    struct node_pool entries;      /* struct watch_entry */
+    struct node_pool buckets;      /* struct watch_bucket */
+    uint32_t *table;               /* mid lookup, open addressing of entry indices */
+    uint32_t tableMask;
+    uint32_t tableUsed;
+    struct watch_ranking *rankings; /* RANK_ALL and one per category */
+    int rankingCount;
+};
+
+/* one line of a top-K answer */
+struct watch_count {
+    unsigned mid;
+    uint32_t count;
+};
+
+/*
+ * Prepares empty counters for categoryCount categories.
+ * Returns 0 on success, -1 on failure
+ */
+int watch_stats_init(struct watch_stats *stats, int categoryCount);
+
+/* Releases every counter */
+void watch_stats_destroy(struct watch_stats *stats);
+
+/*
+ * Counts one more watch of movie mid in O(1).
+ * Returns 0 on success, -1 on failure
+ */
+int watch_stats_record(struct watch_stats *stats, unsigned mid);
+
+/*
+ * Remembers that movie mid belongs to category, so that
+ * its watches also count in the category's ranking, and
+ * the catalog slot its category list node refers to.
+ * Returns 0 on success, -1 on failure
+ */
+int watch_stats_set_category(struct watch_stats *stats, unsigned mid, int category, uint32_t slot);
+
+/*
+ * Catalog slot of movie mid, NIL_INDEX if it was never
+ * distributed or was taken off since
+ */
+uint32_t watch_stats_slot(const struct watch_stats *stats, unsigned mid);
+
+/* Forgets the counters of movie mid, e.g. once it is taken off */
+void watch_stats_retire(struct watch_stats *stats, unsigned mid);
+
+/*
+ * Fills top with up to k most watched movies of ranking
+ * (RANK_ALL or RANK_OF_CATEGORY(c)), highest count first,
+ * in O(k). Returns the number of movies written.
+ */
+unsigned watch_stats_top(const struct watch_stats *stats, int ranking, unsigned k, struct watch_count *top);
+
+#endif